@@ -5,6 +5,9 @@
 #define MAX_TASKS           32
 #define STACK_SIZE          1024
 #define HEAP_SIZE          (32*1024)  // 32KB heap
+#define HEAP_CCM_SIZE      0          // Extra heap in CCMRAM (no DMA access), 0 = none
+#define CCMRAM_BASE        0x10000000u
+#define CCMRAM_SIZE        (64*1024)
 #define MAX_QUEUES         16
 #define MAX_SEMAPHORES     16
 #define MAX_MUTEXES        16
@@ -12,10 +15,33 @@
 #define HIGHEST_PRIORITY   7
 #define TICKS_PER_SECOND   1000
 
+// Heap diagnostics
+#define MEMORY_SIZE_CLASSES  8     // Histogram classes: <=16, <=32, ... <=1024, larger
+#define MEMORY_TRACE_ENABLE  0     // Record alloc/free events for host replay
+#define MEMORY_TRACE_DEPTH   128   // Trace records buffered on target
+#define MEMORY_DMA_ALIGNMENT 16    // Alignment and size granule of DMA buffers
+
+// Per-task allocation caches
+#define MEMORY_CACHE_ENABLE  1     // Serve small allocations from per-task free lists
+#define MEMORY_CACHE_CLASSES 4     // Cached size classes: 16, 32, 64, 128 bytes
+#define MEMORY_CACHE_DEPTH   8     // Max cached blocks per class per task
+
+// Queue statistics
+#define QUEUE_STATS_ENABLE    0    // Occupancy, latency, throughput and blocked time per queue
+#define QUEUE_LATENCY_BUCKETS 8    // Latency classes: 0, 1, 2-3, 4-7, ... ticks, last one open-ended
+
+// Lock profiling
+#define LOCK_STATS_ENABLE     0    // Contention, wait and hold times per Mutex and Semaphore, in CPU cycles
+
+// Interrupt priorities, in NVIC levels (0 = most urgent)
+#define KERNEL_PRIORITY_BITS      4    // Implemented priority bits (__NVIC_PRIO_BITS on the STM32F4)
+#define KERNEL_USE_BASEPRI        1    // Critical sections raise BASEPRI instead of masking every interrupt
+#define KERNEL_INTERRUPT_PRIORITY 15   // SysTick and PendSV, always the least urgent level
+#define KERNEL_SYSCALL_PRIORITY   5    // Most urgent level that may call the kernel; levels 0-4 are never delayed by it
+
+// Interrupt latency benchmark
+#define LATENCY_BENCH_ENABLE      0    // TIM7 probe at level 0 measuring entry latency
+
 typedef void (*task_function_t)(void*);
 
 #endif /* RTOS_CONFIG_H */
-
-/* rtos_types.h */
-#ifndef RTOS_TYPES_H
-#define RTOS_TYPES_H
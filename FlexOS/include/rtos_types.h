@@ -14,18 +14,39 @@ typedef enum {
     TASK_SUSPENDED
 } TaskState;
 
+struct TCB;
+struct Mutex;
+
+// Timeouts are in ticks. 0 never blocks, WAIT_FOREVER never expires.
+// sem_wait() and mutex_lock() predate this and also treat 0 as forever.
+#define WAIT_FOREVER  0xFFFFFFFFu
+
+// Blocked tasks in priority order (FIFO within a priority), linked
+// through the TCBs themselves so no object needs a waiter array
+typedef struct WaitQueue {
+    struct TCB* head;              // Highest priority, longest waiting task
+    struct TCB* tail;              // Lowest priority, most recent task
+} WaitQueue;
+
 typedef struct TCB {
     uint32_t* stack_ptr;           // Current stack pointer
     uint32_t stack[STACK_SIZE];    // Task stack
     TaskState state;               // Current state
-    uint8_t priority;              // Task priority
+    uint8_t priority;              // Task priority, raised while it blocks a mutex waiter
+    uint8_t base_priority;         // Priority assigned at creation
     uint32_t time_slice;           // Time slice for round-robin
     uint32_t blocked_timeout;      // Timeout for blocked state
     task_function_t task_function; // Task function pointer
     void* arg;                     // Task argument
     const char* name;              // Task name
     void* waiting_on;              // Pointer to object task is waiting on
+    void* wait_buffer;             // Data the waker uses while blocked (queue item, event mask)
     struct TCB* next;             // Next TCB in list (for waiting lists)
+    struct TCB* prev;             // Previous TCB in list (for waiting lists)
+    WaitQueue* wait_queue;        // Wait queue the task is linked on, NULL if none
+    struct Mutex* held_mutexes;   // Mutexes owned, linked through next_held
+    struct Mutex* blocked_mutex;  // Mutex the task is waiting for, NULL if none
+    struct Mutex* fast_mutex;     // Mutex mid-way through a lock-free lock/unlock, NULL if none
 } TCB;
 
 typedef struct {
@@ -38,4 +59,3 @@ typedef struct {
 } Scheduler;
 
 #endif /* RTOS_TYPES_H */
-Las
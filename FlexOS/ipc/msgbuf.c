@@ -0,0 +1,333 @@
+// msgbuf.c
+#include <stddef.h>
+#include <string.h>
+#include "msgbuf.h"
+#include "scheduler.h"
+
+static void init_msgbuf(MessageBuffer* mb, uint8_t* storage, uint32_t capacity) {
+    mb->buffer = storage;
+    mb->capacity = capacity;
+    mb->head = 0;
+    mb->tail = 0;
+    mb->used = 0;
+    mb->message_count = 0;
+    waitq_init(&mb->send_waiters);
+    waitq_init(&mb->recv_waiters);
+    mb->is_static = false;
+    mb->peeked = false;
+}
+
+// Largest record (header included) that can be written contiguously now
+static uint32_t largest_slot(const MessageBuffer* mb) {
+    if (mb->used == 0) {
+        return mb->capacity;
+    }
+
+    // Wrapped, the only free space is between tail and head
+    if (mb->tail < mb->head || mb->used == mb->capacity) {
+        return mb->capacity - mb->used;
+    }
+
+    uint32_t to_end = mb->capacity - mb->tail;
+    return to_end > mb->head ? to_end : mb->head;
+}
+
+// Append one message, called with interrupts disabled
+static bool write_message(MessageBuffer* mb, const void* data, uint32_t length) {
+    uint32_t need = MSGBUF_HEADER_SIZE + length;
+
+    if (mb->used == 0) {
+        // Restart at the bottom so the whole buffer is contiguous
+        mb->head = 0;
+        mb->tail = 0;
+    }
+
+    if (need > largest_slot(mb)) {
+        return false;
+    }
+
+    if (mb->tail >= mb->head && mb->capacity - mb->tail < need) {
+        // Skip the end of the buffer, marking it if a header fits there
+        uint32_t skipped = mb->capacity - mb->tail;
+        if (skipped >= MSGBUF_HEADER_SIZE) {
+            uint16_t marker = MSGBUF_WRAP_MARKER;
+            memcpy(mb->buffer + mb->tail, &marker, MSGBUF_HEADER_SIZE);
+        }
+        mb->used += skipped;
+        mb->tail = 0;
+    }
+
+    uint16_t header = (uint16_t)length;
+    memcpy(mb->buffer + mb->tail, &header, MSGBUF_HEADER_SIZE);
+    memcpy(mb->buffer + mb->tail + MSGBUF_HEADER_SIZE, data, length);
+
+    mb->tail += need;
+    if (mb->tail == mb->capacity) {
+        mb->tail = 0;
+    }
+    mb->used += need;
+    mb->message_count++;
+
+    waitq_wake_one(&mb->recv_waiters);
+    return true;
+}
+
+// Find the oldest message, skipping unused space at the end of the
+// buffer. Returns its length. Called with interrupts disabled.
+static uint32_t head_message(MessageBuffer* mb) {
+    if (mb->message_count == 0) {
+        return 0;
+    }
+
+    uint32_t to_end = mb->capacity - mb->head;
+    uint16_t header = MSGBUF_WRAP_MARKER;
+    if (to_end >= MSGBUF_HEADER_SIZE) {
+        memcpy(&header, mb->buffer + mb->head, MSGBUF_HEADER_SIZE);
+    }
+
+    if (header == MSGBUF_WRAP_MARKER) {
+        mb->used -= to_end;
+        mb->head = 0;
+        memcpy(&header, mb->buffer, MSGBUF_HEADER_SIZE);
+    }
+
+    return header;
+}
+
+// Drop the oldest message and let blocked senders retry.
+// Called with interrupts disabled after head_message().
+static void consume_message(MessageBuffer* mb, uint32_t length) {
+    uint32_t size = MSGBUF_HEADER_SIZE + length;
+
+    mb->head += size;
+    if (mb->head == mb->capacity) {
+        mb->head = 0;
+    }
+    mb->used -= size;
+    mb->message_count--;
+
+    // Any of them may fit now, whatever their size
+    waitq_wake_all(&mb->send_waiters);
+}
+
+// Let an ISR reschedule on exit if it woke a task that outranks the one
+// it interrupted. Called with interrupts disabled.
+static void report_switch(bool woke, bool* switch_required) {
+    if (woke && switch_required != NULL && task_is_outranked(get_current_task())) {
+        *switch_required = true;
+    }
+}
+
+// Copy out the oldest message if it fits in size, called with interrupts disabled
+static uint32_t read_message(MessageBuffer* mb, void* buffer, uint32_t size) {
+    uint32_t length = head_message(mb);
+
+    if (length == 0 || length > size) {
+        return 0;
+    }
+
+    memcpy(buffer, mb->buffer + mb->head + MSGBUF_HEADER_SIZE, length);
+    consume_message(mb, length);
+    return length;
+}
+
+bool msgbuf_create(MessageBuffer** mb, uint32_t capacity) {
+    if (!mb || capacity <= MSGBUF_HEADER_SIZE) {
+        return false;
+    }
+
+    MessageBuffer* new_mb = (MessageBuffer*)memory_alloc(sizeof(MessageBuffer));
+    if (!new_mb) {
+        return false;
+    }
+
+    uint8_t* storage = (uint8_t*)memory_alloc(capacity);
+    if (!storage) {
+        memory_free(new_mb);
+        return false;
+    }
+
+    init_msgbuf(new_mb, storage, capacity);
+
+    *mb = new_mb;
+    return true;
+}
+
+bool msgbuf_create_static(MessageBuffer* mb, uint8_t* storage, uint32_t capacity) {
+    if (!mb || !storage || capacity <= MSGBUF_HEADER_SIZE) {
+        return false;
+    }
+
+    init_msgbuf(mb, storage, capacity);
+    mb->is_static = true;
+    return true;
+}
+
+void msgbuf_delete(MessageBuffer* mb) {
+    if (mb && !mb->is_static) {
+        memory_free(mb->buffer);
+        memory_free(mb);
+    }
+}
+
+void msgbuf_reset(MessageBuffer* mb) {
+    if (mb) {
+        disable_interrupts();
+        mb->head = 0;
+        mb->tail = 0;
+        mb->used = 0;
+        mb->message_count = 0;
+        mb->peeked = false;
+        waitq_wake_all(&mb->send_waiters);
+        enable_interrupts();
+    }
+}
+
+uint32_t msgbuf_send(MessageBuffer* mb, const void* data, uint32_t length, uint32_t timeout) {
+    if (!mb || !data || length == 0 || length > msgbuf_max_message(mb)) {
+        return 0;
+    }
+
+    uint32_t start = get_system_ticks();
+
+    disable_interrupts();
+
+    // Woken senders race for the freed space, retry until the timeout is spent
+    while (!write_message(mb, data, length)) {
+        uint32_t remaining = waitq_remaining(timeout, get_system_ticks() - start);
+        if (remaining == 0) {
+            enable_interrupts();
+            return 0;
+        }
+
+        waitq_block(&mb->send_waiters, remaining);
+    }
+
+    enable_interrupts();
+    return length;
+}
+
+uint32_t msgbuf_send_from_isr(MessageBuffer* mb, const void* data, uint32_t length, bool* switch_required) {
+    if (!mb || !data || length == 0 || length > msgbuf_max_message(mb)) {
+        return 0;
+    }
+
+    // A nested ISR may use the same buffer and its waiter lists
+    uint32_t prev = enter_critical_from_isr();
+    bool written = write_message(mb, data, length);
+    report_switch(written, switch_required);
+    exit_critical_from_isr(prev);
+
+    return written ? length : 0;
+}
+
+uint32_t msgbuf_receive(MessageBuffer* mb, void* buffer, uint32_t size, uint32_t timeout) {
+    if (!mb || !buffer) {
+        return 0;
+    }
+
+    uint32_t start = get_system_ticks();
+
+    disable_interrupts();
+
+    while (mb->message_count == 0 || mb->peeked) {
+        uint32_t remaining = waitq_remaining(timeout, get_system_ticks() - start);
+        if (remaining == 0) {
+            enable_interrupts();
+            return 0;
+        }
+
+        waitq_block(&mb->recv_waiters, remaining);
+    }
+
+    uint32_t length = read_message(mb, buffer, size);
+
+    enable_interrupts();
+    return length;
+}
+
+uint32_t msgbuf_receive_from_isr(MessageBuffer* mb, void* buffer, uint32_t size, bool* switch_required) {
+    if (!mb || !buffer) {
+        return 0;
+    }
+
+    uint32_t prev = enter_critical_from_isr();
+    uint32_t length = mb->peeked ? 0 : read_message(mb, buffer, size);
+    report_switch(length > 0, switch_required);
+    exit_critical_from_isr(prev);
+
+    return length;
+}
+
+uint32_t msgbuf_peek(MessageBuffer* mb, const void** data) {
+    if (!mb || !data) {
+        return 0;
+    }
+
+    disable_interrupts();
+
+    // Only one message can be lent out at a time
+    uint32_t length = mb->peeked ? 0 : head_message(mb);
+    if (length > 0) {
+        // The message stays stored until released, so senders can't reuse it
+        *data = mb->buffer + mb->head + MSGBUF_HEADER_SIZE;
+        mb->peeked = true;
+    }
+
+    enable_interrupts();
+    return length;
+}
+
+void msgbuf_release(MessageBuffer* mb) {
+    if (!mb) {
+        return;
+    }
+
+    disable_interrupts();
+
+    if (!mb->peeked) {
+        enable_interrupts();
+        return;
+    }
+
+    consume_message(mb, head_message(mb));
+    mb->peeked = false;
+
+    // Another receiver may have blocked while the message was lent out
+    if (mb->message_count > 0) {
+        waitq_wake_one(&mb->recv_waiters);
+    }
+
+    enable_interrupts();
+}
+
+uint32_t msgbuf_next_length(MessageBuffer* mb) {
+    if (!mb) {
+        return 0;
+    }
+
+    disable_interrupts();
+    uint32_t length = head_message(mb);
+    enable_interrupts();
+
+    return length;
+}
+
+uint32_t msgbuf_get_count(const MessageBuffer* mb) {
+    return mb ? mb->message_count : 0;
+}
+
+// Largest message that could be sent without blocking
+uint32_t msgbuf_get_free(const MessageBuffer* mb) {
+    if (!mb) {
+        return 0;
+    }
+
+    uint32_t slot = largest_slot(mb);
+    return slot > MSGBUF_HEADER_SIZE ? slot - MSGBUF_HEADER_SIZE : 0;
+}
+
+uint32_t msgbuf_max_message(const MessageBuffer* mb) {
+    uint32_t max = mb->capacity - MSGBUF_HEADER_SIZE;
+    return max < MSGBUF_WRAP_MARKER ? max : MSGBUF_WRAP_MARKER - 1;
+}
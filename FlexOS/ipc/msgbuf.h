@@ -0,0 +1,62 @@
+// msgbuf.h
+#ifndef RTOS_MSGBUF_H
+#define RTOS_MSGBUF_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "memory.h"
+#include "waitq.h"
+
+// Each message is stored as a 16-bit length followed by its payload
+#define MSGBUF_HEADER_SIZE  2u
+#define MSGBUF_WRAP_MARKER  0xFFFFu
+
+// Variable-length messages packed back to back in a byte ring, so RAM use
+// follows the payload rather than the largest message. A message never
+// straddles the end of the storage, which lets receivers read it in place;
+// space left at the end when a message doesn't fit is skipped.
+typedef struct {
+    uint8_t* buffer;                 // Message storage
+    uint32_t capacity;               // Size of buffer in bytes
+    uint32_t head;                   // Offset of the oldest message
+    uint32_t tail;                   // Offset for the next message
+    uint32_t used;                   // Bytes in use, headers and skipped space included
+    uint32_t message_count;          // Messages currently stored
+    WaitQueue send_waiters;          // Tasks waiting for space
+    WaitQueue recv_waiters;          // Tasks waiting for a message
+    bool is_static;                  // Storage supplied by the caller
+    bool peeked;                     // Oldest message lent out by msgbuf_peek()
+} MessageBuffer;
+
+// Compile-time initializer, storage must be an array
+#define MSGBUF_STATIC_INIT(storage) { \
+    .buffer = (storage),              \
+    .capacity = sizeof(storage),      \
+    .is_static = true                 \
+}
+
+bool msgbuf_create(MessageBuffer** mb, uint32_t capacity);
+bool msgbuf_create_static(MessageBuffer* mb, uint8_t* storage, uint32_t capacity);
+void msgbuf_delete(MessageBuffer* mb);
+void msgbuf_reset(MessageBuffer* mb);
+
+// Send returns length, or 0 if the message didn't fit in time. Receive
+// returns the message length, or 0 if none arrived or it is larger than
+// size (the message is then left in place). Timeout 0 never blocks,
+// WAIT_FOREVER never expires. The _from_isr variants set *switch_required
+// (if not NULL) when they wake a task that outranks the interrupted one.
+uint32_t msgbuf_send(MessageBuffer* mb, const void* data, uint32_t length, uint32_t timeout);
+uint32_t msgbuf_send_from_isr(MessageBuffer* mb, const void* data, uint32_t length, bool* switch_required);
+uint32_t msgbuf_receive(MessageBuffer* mb, void* buffer, uint32_t size, uint32_t timeout);
+uint32_t msgbuf_receive_from_isr(MessageBuffer* mb, void* buffer, uint32_t size, bool* switch_required);
+
+// Zero-copy read of the oldest message, consumed by msgbuf_release()
+uint32_t msgbuf_peek(MessageBuffer* mb, const void** data);
+void msgbuf_release(MessageBuffer* mb);
+
+uint32_t msgbuf_next_length(MessageBuffer* mb);
+uint32_t msgbuf_get_count(const MessageBuffer* mb);
+uint32_t msgbuf_get_free(const MessageBuffer* mb);
+uint32_t msgbuf_max_message(const MessageBuffer* mb);
+
+#endif // RTOS_MSGBUF_H
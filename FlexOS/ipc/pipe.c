@@ -0,0 +1,265 @@
+// pipe.c
+#include <stddef.h>
+#include "pipe.h"
+#include "memory.h"
+#include "scheduler.h"
+
+// Bytes a read of length bytes waits for before returning
+static uint32_t read_threshold(const Pipe* pipe, uint32_t length) {
+    return length < pipe->trigger_level ? length : pipe->trigger_level;
+}
+
+// Wake every reader whose threshold is met, called with interrupts disabled.
+// Each blocked reader keeps its requested length in wait_buffer.
+static void data_added(Pipe* pipe) {
+    uint32_t count = ringbuf_get_count(&pipe->ring);
+
+    TCB* task = waitq_peek(&pipe->read_waiters);
+    while (task != NULL) {
+        TCB* next = task->next;
+
+        if (count >= read_threshold(pipe, *(const uint32_t*)task->wait_buffer)) {
+            waitq_remove(task);
+            unblock_task(task);
+        }
+
+        task = next;
+    }
+}
+
+// Let blocked writers fill the freed space, called with interrupts disabled
+static void space_freed(Pipe* pipe) {
+    waitq_wake_all(&pipe->write_waiters);
+
+    // A reader that lost the race to us may still be satisfied
+    data_added(pipe);
+}
+
+// Let an ISR reschedule on exit if it woke a task that outranks the one
+// it interrupted. Called with interrupts disabled.
+static void report_switch(bool* switch_required) {
+    if (switch_required != NULL && task_is_outranked(get_current_task())) {
+        *switch_required = true;
+    }
+}
+
+static void init_pipe(Pipe* pipe) {
+    pipe->trigger_level = 1;
+    waitq_init(&pipe->read_waiters);
+    waitq_init(&pipe->write_waiters);
+    pipe->is_static = false;
+}
+
+bool pipe_create(Pipe** pipe, uint32_t capacity) {
+    if (!pipe) {
+        return false;
+    }
+
+    Pipe* new_pipe = (Pipe*)memory_alloc(sizeof(Pipe));
+    if (!new_pipe) {
+        return false;
+    }
+
+    uint8_t* storage = (uint8_t*)memory_alloc(capacity);
+    if (!storage || !ringbuf_init(&new_pipe->ring, storage, capacity)) {
+        memory_free(storage);
+        memory_free(new_pipe);
+        return false;
+    }
+
+    init_pipe(new_pipe);
+
+    *pipe = new_pipe;
+    return true;
+}
+
+bool pipe_create_static(Pipe* pipe, uint8_t* storage, uint32_t capacity) {
+    if (!pipe || !ringbuf_init(&pipe->ring, storage, capacity)) {
+        return false;
+    }
+
+    init_pipe(pipe);
+    pipe->is_static = true;
+    return true;
+}
+
+void pipe_delete(Pipe* pipe) {
+    if (pipe && !pipe->is_static) {
+        memory_free(pipe->ring.buffer);
+        memory_free(pipe);
+    }
+}
+
+void pipe_reset(Pipe* pipe) {
+    if (pipe) {
+        disable_interrupts();
+        ringbuf_reset(&pipe->ring);
+        waitq_wake_all(&pipe->write_waiters);
+        enable_interrupts();
+    }
+}
+
+bool pipe_set_trigger_level(Pipe* pipe, uint32_t level) {
+    if (!pipe || level == 0 || level > pipe->ring.mask + 1) {
+        return false;
+    }
+
+    disable_interrupts();
+    pipe->trigger_level = level;
+    data_added(pipe);
+    enable_interrupts();
+
+    return true;
+}
+
+uint32_t pipe_write(Pipe* pipe, const void* data, uint32_t length, uint32_t timeout) {
+    if (!pipe || !data) {
+        return 0;
+    }
+
+    const uint8_t* src = (const uint8_t*)data;
+    uint32_t written = 0;
+    uint32_t start = get_system_ticks();
+
+    disable_interrupts();
+
+    for (;;) {
+        uint32_t n = ringbuf_write(&pipe->ring, src + written, length - written);
+        if (n > 0) {
+            written += n;
+            data_added(pipe);
+        }
+
+        if (written == length) {
+            break;
+        }
+
+        uint32_t remaining = waitq_remaining(timeout, get_system_ticks() - start);
+        if (remaining == 0) {
+            break;
+        }
+
+        waitq_block(&pipe->write_waiters, remaining);
+    }
+
+    enable_interrupts();
+    return written;
+}
+
+uint32_t pipe_write_from_isr(Pipe* pipe, const void* data, uint32_t length, bool* switch_required) {
+    if (!pipe || !data) {
+        return 0;
+    }
+
+    // The ring is single-producer safe, only the waiter lists need masking
+    uint32_t n = ringbuf_write(&pipe->ring, data, length);
+    if (n > 0) {
+        uint32_t prev = enter_critical_from_isr();
+        data_added(pipe);
+        report_switch(switch_required);
+        exit_critical_from_isr(prev);
+    }
+
+    return n;
+}
+
+uint32_t pipe_read(Pipe* pipe, void* buffer, uint32_t length, uint32_t timeout) {
+    if (!pipe || !buffer || length == 0) {
+        return 0;
+    }
+
+    TCB* current_task = get_current_task();
+    uint32_t start = get_system_ticks();
+
+    disable_interrupts();
+
+    // The trigger level may change while we wait, so recheck it each time
+    while (ringbuf_get_count(&pipe->ring) < read_threshold(pipe, length)) {
+        uint32_t remaining = waitq_remaining(timeout, get_system_ticks() - start);
+        if (remaining == 0) {
+            break;
+        }
+
+        current_task->wait_buffer = &length;
+        waitq_block(&pipe->read_waiters, remaining);
+        current_task->wait_buffer = NULL;
+    }
+
+    uint32_t n = ringbuf_read(&pipe->ring, buffer, length);
+    if (n > 0) {
+        space_freed(pipe);
+    }
+
+    enable_interrupts();
+    return n;
+}
+
+uint32_t pipe_read_from_isr(Pipe* pipe, void* buffer, uint32_t length, bool* switch_required) {
+    if (!pipe || !buffer) {
+        return 0;
+    }
+
+    uint32_t n = ringbuf_read(&pipe->ring, buffer, length);
+    if (n > 0) {
+        uint32_t prev = enter_critical_from_isr();
+        space_freed(pipe);
+        report_switch(switch_required);
+        exit_critical_from_isr(prev);
+    }
+
+    return n;
+}
+
+uint32_t pipe_write_span(Pipe* pipe, uint8_t** span) {
+    if (!pipe || !span) {
+        return 0;
+    }
+
+    disable_interrupts();
+    uint32_t n = ringbuf_write_span(&pipe->ring, span);
+    enable_interrupts();
+
+    return n;
+}
+
+void pipe_write_commit(Pipe* pipe, uint32_t length) {
+    if (!pipe || length == 0) {
+        return;
+    }
+
+    disable_interrupts();
+    ringbuf_write_commit(&pipe->ring, length);
+    data_added(pipe);
+    enable_interrupts();
+}
+
+uint32_t pipe_read_span(Pipe* pipe, const uint8_t** span) {
+    if (!pipe || !span) {
+        return 0;
+    }
+
+    disable_interrupts();
+    uint32_t n = ringbuf_read_span(&pipe->ring, span);
+    enable_interrupts();
+
+    return n;
+}
+
+void pipe_read_release(Pipe* pipe, uint32_t length) {
+    if (!pipe || length == 0) {
+        return;
+    }
+
+    disable_interrupts();
+    ringbuf_read_release(&pipe->ring, length);
+    space_freed(pipe);
+    enable_interrupts();
+}
+
+uint32_t pipe_get_count(const Pipe* pipe) {
+    return pipe ? ringbuf_get_count(&pipe->ring) : 0;
+}
+
+uint32_t pipe_get_space(const Pipe* pipe) {
+    return pipe ? ringbuf_get_space(&pipe->ring) : 0;
+}
@@ -0,0 +1,56 @@
+// pipe.h
+#ifndef RTOS_PIPE_H
+#define RTOS_PIPE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ringbuf.h"
+#include "waitq.h"
+
+// Byte stream between tasks (or an ISR and tasks) on top of a RingBuffer.
+// Blocked readers are only woken once trigger_level bytes are buffered
+// (or fewer, if that is all they asked for), so a parser can sleep until
+// a whole header or frame has arrived.
+typedef struct {
+    RingBuffer ring;                 // Byte storage, power-of-two capacity
+    uint32_t trigger_level;          // Bytes needed to wake a blocked reader
+    WaitQueue read_waiters;          // Tasks waiting for data
+    WaitQueue write_waiters;         // Tasks waiting for space
+    bool is_static;                  // Storage supplied by the caller
+} Pipe;
+
+// Compile-time initializer, storage must be an array with a power-of-two size
+#define PIPE_STATIC_INIT(storage) {        \
+    .ring = RINGBUF_STATIC_INIT(storage),  \
+    .trigger_level = 1,                    \
+    .is_static = true                      \
+}
+
+bool pipe_create(Pipe** pipe, uint32_t capacity);
+bool pipe_create_static(Pipe* pipe, uint8_t* storage, uint32_t capacity);
+void pipe_delete(Pipe* pipe);
+void pipe_reset(Pipe* pipe);
+bool pipe_set_trigger_level(Pipe* pipe, uint32_t level);
+
+// Write blocks until all length bytes are in the pipe or the timeout
+// expires, and returns how many went in. Read waits for the trigger level
+// (or length, if smaller) and returns up to length bytes; on timeout it
+// returns whatever is buffered. Timeout 0 never blocks, WAIT_FOREVER
+// never expires. The _from_isr variants set *switch_required (if not
+// NULL) when they wake a task that outranks the interrupted one.
+uint32_t pipe_write(Pipe* pipe, const void* data, uint32_t length, uint32_t timeout);
+uint32_t pipe_write_from_isr(Pipe* pipe, const void* data, uint32_t length, bool* switch_required);
+uint32_t pipe_read(Pipe* pipe, void* buffer, uint32_t length, uint32_t timeout);
+uint32_t pipe_read_from_isr(Pipe* pipe, void* buffer, uint32_t length, bool* switch_required);
+
+// Zero-copy access to the largest contiguous span, for one reader and
+// one writer at a time. The span stays valid until released or committed.
+uint32_t pipe_write_span(Pipe* pipe, uint8_t** span);
+void pipe_write_commit(Pipe* pipe, uint32_t length);
+uint32_t pipe_read_span(Pipe* pipe, const uint8_t** span);
+void pipe_read_release(Pipe* pipe, uint32_t length);
+
+uint32_t pipe_get_count(const Pipe* pipe);
+uint32_t pipe_get_space(const Pipe* pipe);
+
+#endif // RTOS_PIPE_H
@@ -1,74 +1,8 @@
-// queue.h
-#ifndef RTOS_QUEUE_H
-#define RTOS_QUEUE_H
-
-#include <stdint.h>
-#include <stdbool.h>
-#include "memory.h"
-
-// Queue error codes
-typedef enum {
-    QUEUE_OK,
-    QUEUE_FULL,
-    QUEUE_EMPTY,
-    QUEUE_ERROR,
-    QUEUE_TIMEOUT
-} QueueStatus;
-
-// Queue notification type
-typedef enum {
-    QUEUE_NOTIFY_ON_SEND,
-    QUEUE_NOTIFY_ON_RECEIVE,
-    QUEUE_NOTIFY_ON_FULL,
-    QUEUE_NOTIFY_ON_EMPTY
-} QueueNotifyType;
-
-// Queue notification callback
-typedef void (*QueueCallback)(void* queue, void* context);
-
-// Queue structure
-typedef struct {
-    void* buffer;                     // Queue data buffer
-    uint32_t item_size;              // Size of each item
-    uint32_t queue_length;           // Maximum number of items
-    uint32_t items_count;            // Current number of items
-    uint32_t head;                   // Read index
-    uint32_t tail;                   // Write index
-    uint32_t waiting_tasks_send[32]; // Tasks waiting to send
-    uint32_t waiting_tasks_recv[32]; // Tasks waiting to receive
-    uint32_t waiting_count_send;     // Number of tasks waiting to send
-    uint32_t waiting_count_recv;     // Number of tasks waiting to receive
-    bool is_isr_enabled;             // ISR usage flag
-    QueueCallback notify_callback;    // Notification callback
-    void* notify_context;            // Notification context
-    QueueNotifyType notify_type;     // Notification type
-    uint32_t overflow_count;         // Number of overflow events
-    uint32_t underflow_count;        // Number of underflow events
-} Queue;
-
-// Queue functions
-QueueStatus queue_create(Queue** queue, uint32_t item_size, uint32_t queue_length);
-void queue_delete(Queue* queue);
-QueueStatus queue_send(Queue* queue, const void* item, uint32_t timeout);
-QueueStatus queue_send_from_isr(Queue* queue, const void* item);
-QueueStatus queue_receive(Queue* queue, void* buffer, uint32_t timeout);
-QueueStatus queue_receive_from_isr(Queue* queue, void* buffer);
-QueueStatus queue_peek(Queue* queue, void* buffer);
-void queue_reset(Queue* queue);
-uint32_t queue_get_count(const Queue* queue);
-bool queue_is_full(const Queue* queue);
-bool queue_is_empty(const Queue* queue);
-void queue_set_notification(Queue* queue, QueueCallback callback, void* context, QueueNotifyType type);
-uint32_t queue_get_space_available(const Queue* queue);
-QueueStatus queue_send_to_front(Queue* queue, const void* item, uint32_t timeout);
-QueueStatus queue_send_to_back(Queue* queue, const void* item, uint32_t timeout);
-QueueStatus queue_overwrite(Queue* queue, const void* item);
-
-#endif // RTOS_QUEUE_H
-
 // queue.c
 #include "queue.h"
 #include "scheduler.h"
+#include "waitq.h"
+#include "queueset.h"
 #include <string.h>
 
 // Internal helper functions
@@ -88,6 +22,317 @@ static void notify_queue_event(Queue* queue, QueueNotifyType event_type) {
     }
 }
 
+// Resume the highest priority receiver, called with interrupts disabled
+static void wake_receiver(Queue* queue) {
+    waitq_wake_one(&queue->recv_waiters);
+}
+
+// Resume the highest priority sender, called with interrupts disabled
+static void wake_sender(Queue* queue) {
+    waitq_wake_one(&queue->send_waiters);
+}
+
+// Let an ISR reschedule on exit if it woke a task that outranks the one
+// it interrupted. Called with interrupts disabled.
+static void report_switch(bool* switch_required) {
+    if (switch_required != NULL && task_is_outranked(get_current_task())) {
+        *switch_required = true;
+    }
+}
+
+// Post one handle per newly queued item to the owning queue set, if any.
+// Called with interrupts disabled.
+static void notify_queue_set(Queue* queue, uint32_t count) {
+    if (queue->queue_set != NULL) {
+        for (uint32_t i = 0; i < count; i++) {
+            queueset_notify(queue->queue_set, queue);
+        }
+    }
+}
+
+#if QUEUE_STATS_ENABLE
+static void stats_latency(QueueStats* stats, uint32_t latency) {
+    uint32_t bucket = (latency == 0) ? 0 : 32 - (uint32_t)__builtin_clz(latency);
+
+    if (bucket >= QUEUE_LATENCY_BUCKETS) {
+        bucket = QUEUE_LATENCY_BUCKETS - 1;
+    }
+
+    stats->latency[bucket]++;
+    if (latency > stats->max_latency) {
+        stats->max_latency = latency;
+    }
+}
+
+static void stats_received(QueueStats* stats, uint32_t count, uint32_t now) {
+    stats->received += count;
+    stats->window_count += count;
+
+    // Close the throughput window once a second has passed
+    uint32_t elapsed = now - stats->window_start;
+    if (elapsed >= TICKS_PER_SECOND) {
+        stats->throughput = (uint32_t)((uint64_t)stats->window_count * TICKS_PER_SECOND / elapsed);
+        stats->window_start = now;
+        stats->window_count = 0;
+    }
+}
+
+// Record count items stored from slot position on, after items_count is
+// updated. Called with interrupts disabled.
+static void stats_enqueued(Queue* queue, uint32_t position, uint32_t count) {
+    QueueStats* stats = &queue->stats;
+
+    stats->sent += count;
+    if (queue->items_count > stats->high_water) {
+        stats->high_water = queue->items_count;
+    }
+
+    if (queue->timestamps != NULL) {
+        uint32_t now = get_system_ticks();
+        for (uint32_t i = 0; i < count; i++) {
+            queue->timestamps[position] = now;
+            if (++position == queue->queue_length) {
+                position = 0;
+            }
+        }
+    }
+}
+
+// Record count items taken from slot position on, called with interrupts disabled
+static void stats_dequeued(Queue* queue, uint32_t position, uint32_t count) {
+    uint32_t now = get_system_ticks();
+
+    if (queue->timestamps != NULL) {
+        for (uint32_t i = 0; i < count; i++) {
+            stats_latency(&queue->stats, now - queue->timestamps[position]);
+            if (++position == queue->queue_length) {
+                position = 0;
+            }
+        }
+    }
+
+    stats_received(&queue->stats, count, now);
+}
+
+// An item passed straight to a blocked receiver, called with interrupts disabled
+static void stats_handoff(Queue* queue) {
+    queue->stats.sent++;
+    stats_latency(&queue->stats, 0);
+    stats_received(&queue->stats, 1, get_system_ticks());
+}
+#else
+static inline void stats_enqueued(Queue* queue, uint32_t position, uint32_t count) {
+    (void)queue; (void)position; (void)count;
+}
+
+static inline void stats_dequeued(Queue* queue, uint32_t position, uint32_t count) {
+    (void)queue; (void)position; (void)count;
+}
+
+static inline void stats_handoff(Queue* queue) {
+    (void)queue;
+}
+#endif
+
+// Block the current task on one of the queue's wait lists. A waker may
+// complete the operation through buffer (NULL if the caller retries
+// instead). Returns true if it did. Called with interrupts disabled.
+static bool wait_on_queue(Queue* queue, WaitQueue* waiters, void* buffer, uint32_t timeout) {
+    TCB* current = get_current_task();
+
+    current->wait_buffer = buffer;
+
+#if QUEUE_STATS_ENABLE
+    uint32_t start = get_system_ticks();
+    waitq_block(waiters, timeout);
+
+    uint32_t blocked = get_system_ticks() - start;
+    if (waiters == &queue->send_waiters) {
+        queue->stats.send_blocked_ticks += blocked;
+    } else {
+        queue->stats.recv_blocked_ticks += blocked;
+    }
+#else
+    (void)queue;
+    waitq_block(waiters, timeout);
+#endif
+
+    bool handed_off = (buffer != NULL && current->wait_buffer == NULL);
+    current->wait_buffer = NULL;
+    return handed_off;
+}
+
+// Copy an item straight into the buffer of the first waiting receiver
+// and complete its receive. Fails if no receiver is blocked with a buffer.
+// Called with interrupts disabled.
+static bool handoff_to_receiver(Queue* queue, const void* item) {
+    TCB* receiver = waitq_peek(&queue->recv_waiters);
+    if (receiver == NULL || receiver->wait_buffer == NULL) {
+        return false;
+    }
+
+    memcpy(receiver->wait_buffer, item, queue->item_size);
+    receiver->wait_buffer = NULL;
+    stats_handoff(queue);
+    wake_receiver(queue);
+    return true;
+}
+
+// Refill a slot freed by a receive from the first waiting sender and
+// complete its send, or just wake it if it has no item to hand over.
+// Called with interrupts disabled.
+static void refill_from_sender(Queue* queue) {
+    TCB* sender = waitq_peek(&queue->send_waiters);
+    if (sender == NULL) {
+        return;
+    }
+
+    if (sender->wait_buffer != NULL && !queue->send_loaned) {
+        copy_to_queue(queue, sender->wait_buffer, queue->tail);
+        queue->items_count++;
+        stats_enqueued(queue, queue->tail, 1);
+        queue->tail = (queue->tail + 1) % queue->queue_length;
+        sender->wait_buffer = NULL;
+        notify_queue_set(queue, 1);
+    }
+
+    wake_sender(queue);
+}
+
+// Deliver an item to a blocked receiver or append it to the queue.
+// Called with interrupts disabled and space available.
+static void put_to_queue(Queue* queue, const void* item) {
+    if (!handoff_to_receiver(queue, item)) {
+        copy_to_queue(queue, item, queue->tail);
+        queue->items_count++;
+        stats_enqueued(queue, queue->tail, 1);
+        queue->tail = (queue->tail + 1) % queue->queue_length;
+
+        // Wake up one waiting receiver if any
+        wake_receiver(queue);
+        notify_queue_set(queue, 1);
+    }
+
+    notify_queue_event(queue, QUEUE_NOTIFY_ON_SEND);
+}
+
+// Remove the oldest item and let a blocked sender take its slot.
+// Called with interrupts disabled and an item available.
+static void take_from_queue(Queue* queue, void* buffer) {
+    copy_from_queue(queue, buffer, queue->head);
+    stats_dequeued(queue, queue->head, 1);
+    queue->head = (queue->head + 1) % queue->queue_length;
+    queue->items_count--;
+
+    // Hand the freed slot to one waiting sender if any
+    refill_from_sender(queue);
+
+    notify_queue_event(queue, QUEUE_NOTIFY_ON_RECEIVE);
+}
+
+// Move up to count items into the queue with at most two copies, after
+// serving blocked receivers directly. Called with interrupts disabled.
+static uint32_t send_batch(Queue* queue, const uint8_t* items, uint32_t count) {
+    uint32_t moved = 0;
+
+    while (moved < count && handoff_to_receiver(queue, items + moved * queue->item_size)) {
+        moved++;
+    }
+
+    uint32_t n = count - moved;
+    uint32_t space = queue->queue_length - queue->items_count;
+    if (n > space) {
+        n = space;
+    }
+
+    if (n > 0) {
+        uint32_t first = queue->queue_length - queue->tail;
+        if (first > n) {
+            first = n;
+        }
+
+        const uint8_t* src = items + moved * queue->item_size;
+        memcpy((uint8_t*)queue->buffer + queue->tail * queue->item_size, src, first * queue->item_size);
+        memcpy(queue->buffer, src + first * queue->item_size, (n - first) * queue->item_size);
+
+        queue->items_count += n;
+        stats_enqueued(queue, queue->tail, n);
+        queue->tail += n;
+        if (queue->tail >= queue->queue_length) {
+            queue->tail -= queue->queue_length;
+        }
+        moved += n;
+
+        // Wake up one waiting receiver if any
+        wake_receiver(queue);
+        notify_queue_set(queue, n);
+    }
+
+    if (moved > 0) {
+        notify_queue_event(queue, QUEUE_NOTIFY_ON_SEND);
+    }
+
+    return moved;
+}
+
+// Move up to count items out of the queue with at most two copies, then
+// let blocked senders refill the freed slots. Called with interrupts disabled.
+static uint32_t receive_batch(Queue* queue, uint8_t* items, uint32_t count) {
+    uint32_t n = count < queue->items_count ? count : queue->items_count;
+
+    if (n == 0) {
+        return 0;
+    }
+
+    uint32_t first = queue->queue_length - queue->head;
+    if (first > n) {
+        first = n;
+    }
+
+    memcpy(items, (const uint8_t*)queue->buffer + queue->head * queue->item_size, first * queue->item_size);
+    memcpy(items + first * queue->item_size, queue->buffer, (n - first) * queue->item_size);
+    stats_dequeued(queue, queue->head, n);
+
+    queue->head += n;
+    if (queue->head >= queue->queue_length) {
+        queue->head -= queue->queue_length;
+    }
+    queue->items_count -= n;
+
+    // Hand the freed slots to waiting senders
+    for (uint32_t i = 0; i < n && !waitq_is_empty(&queue->send_waiters); i++) {
+        refill_from_sender(queue);
+    }
+
+    notify_queue_event(queue, QUEUE_NOTIFY_ON_RECEIVE);
+    return n;
+}
+
+static void init_queue(Queue* queue, void* buffer, uint32_t item_size, uint32_t queue_length) {
+    queue->buffer = buffer;
+    queue->item_size = item_size;
+    queue->queue_length = queue_length;
+    queue->items_count = 0;
+    queue->head = 0;
+    queue->tail = 0;
+    waitq_init(&queue->send_waiters);
+    waitq_init(&queue->recv_waiters);
+    queue->is_isr_enabled = false;
+    queue->notify_callback = NULL;
+    queue->notify_context = NULL;
+    queue->overflow_count = 0;
+    queue->underflow_count = 0;
+    queue->is_static = false;
+    queue->send_loaned = false;
+    queue->recv_loaned = false;
+    queue->queue_set = NULL;
+#if QUEUE_STATS_ENABLE
+    queue->timestamps = NULL;
+    memset(&queue->stats, 0, sizeof(queue->stats));
+    queue->stats.window_start = get_system_ticks();
+#endif
+}
+
 QueueStatus queue_create(Queue** queue, uint32_t item_size, uint32_t queue_length) {
     if (!queue || item_size == 0 || queue_length == 0) {
         return QUEUE_ERROR;
@@ -107,29 +352,37 @@ QueueStatus queue_create(Queue** queue, uint32_t item_size, uint32_t queue_lengt
     }
 
     // Initialize queue structure
-    new_queue->buffer = buffer;
-    new_queue->item_size = item_size;
-    new_queue->queue_length = queue_length;
-    new_queue->items_count = 0;
-    new_queue->head = 0;
-    new_queue->tail = 0;
-    new_queue->waiting_count_send = 0;
-    new_queue->waiting_count_recv = 0;
-    new_queue->is_isr_enabled = false;
-    new_queue->notify_callback = NULL;
-    new_queue->notify_context = NULL;
-    new_queue->overflow_count = 0;
-    new_queue->underflow_count = 0;
+    init_queue(new_queue, buffer, item_size, queue_length);
+
+#if QUEUE_STATS_ENABLE
+    // Latency tracking is optional, the queue works without it
+    new_queue->timestamps = (uint32_t*)memory_alloc(queue_length * sizeof(uint32_t));
+#endif
 
     *queue = new_queue;
     return QUEUE_OK;
 }
 
+QueueStatus queue_create_static(Queue* queue, void* buffer, uint32_t item_size, uint32_t queue_length) {
+    if (!queue || !buffer || item_size == 0 || queue_length == 0) {
+        return QUEUE_ERROR;
+    }
+
+    // Caller owns both the structure and the buffer, nothing is allocated
+    init_queue(queue, buffer, item_size, queue_length);
+    queue->is_static = true;
+
+    return QUEUE_OK;
+}
+
 void queue_delete(Queue* queue) {
-    if (queue) {
+    if (queue && !queue->is_static) {
         if (queue->buffer) {
             memory_free(queue->buffer);
         }
+#if QUEUE_STATS_ENABLE
+        memory_free(queue->timestamps);
+#endif
         memory_free(queue);
     }
 }
@@ -141,25 +394,13 @@ QueueStatus queue_send(Queue* queue, const void* item, uint32_t timeout) {
 
     disable_interrupts();
 
-    if (!queue_is_full(queue)) {
-        copy_to_queue(queue, item, queue->tail);
-        queue->tail = (queue->tail + 1) % queue->queue_length;
-        queue->items_count++;
-
-        // Wake up one waiting receiver if any
-        if (queue->waiting_count_recv > 0) {
-            uint32_t task_to_wake = queue->waiting_tasks_recv[0];
-
-            // Remove task from waiting list
-            for (uint32_t i = 0; i < queue->waiting_count_recv - 1; i++) {
-                queue->waiting_tasks_recv[i] = queue->waiting_tasks_recv[i + 1];
-            }
-            queue->waiting_count_recv--;
-
-            resume_task(task_to_wake);
-        }
+    if (queue->send_loaned) {
+        enable_interrupts();
+        return QUEUE_BUSY;
+    }
 
-        notify_queue_event(queue, QUEUE_NOTIFY_ON_SEND);
+    if (!queue_is_full(queue)) {
+        put_to_queue(queue, item);
 
         enable_interrupts();
         return QUEUE_OK;
@@ -171,31 +412,42 @@ QueueStatus queue_send(Queue* queue, const void* item, uint32_t timeout) {
         return QUEUE_FULL;
     }
 
-    // Add current task to sending waiting list
-    uint32_t current_task = get_current_task_id();
-    queue->waiting_tasks_send[queue->waiting_count_send++] = current_task;
+    // Add current task to sending waiting list, a receiver that frees a
+    // slot copies the item from here and completes the send for us
+    QueueStatus status = QUEUE_OK;
+    if (!wait_on_queue(queue, &queue->send_waiters, (void*)item, timeout)) {
+        if (!queue_is_full(queue) && !queue->send_loaned) {
+            put_to_queue(queue, item);
+        } else {
+            status = QUEUE_TIMEOUT;
+        }
+    }
 
     enable_interrupts();
-    block_task(timeout);
-
-    return queue_is_full(queue) ? QUEUE_TIMEOUT : QUEUE_OK;
+    return status;
 }
 
-QueueStatus queue_send_from_isr(Queue* queue, const void* item) {
+QueueStatus queue_send_from_isr(Queue* queue, const void* item, bool* switch_required) {
     if (!queue || !item || !queue->is_isr_enabled) {
         return QUEUE_ERROR;
     }
 
-    if (!queue_is_full(queue)) {
-        copy_to_queue(queue, item, queue->tail);
-        queue->tail = (queue->tail + 1) % queue->queue_length;
-        queue->items_count++;
-        notify_queue_event(queue, QUEUE_NOTIFY_ON_SEND);
-        return QUEUE_OK;
+    // A nested ISR may use the same queue and its waiter lists
+    uint32_t prev = enter_critical_from_isr();
+    QueueStatus status = QUEUE_OK;
+
+    if (queue->send_loaned) {
+        status = QUEUE_BUSY;
+    } else if (!queue_is_full(queue)) {
+        put_to_queue(queue, item);
+        report_switch(switch_required);
+    } else {
+        queue->overflow_count++;
+        status = QUEUE_FULL;
     }
 
-    queue->overflow_count++;
-    return QUEUE_FULL;
+    exit_critical_from_isr(prev);
+    return status;
 }
 
 QueueStatus queue_receive(Queue* queue, void* buffer, uint32_t timeout) {
@@ -205,25 +457,13 @@ QueueStatus queue_receive(Queue* queue, void* buffer, uint32_t timeout) {
 
     disable_interrupts();
 
-    if (!queue_is_empty(queue)) {
-        copy_from_queue(queue, buffer, queue->head);
-        queue->head = (queue->head + 1) % queue->queue_length;
-        queue->items_count--;
-
-        // Wake up one waiting sender if any
-        if (queue->waiting_count_send > 0) {
-            uint32_t task_to_wake = queue->waiting_tasks_send[0];
-
-            // Remove task from waiting list
-            for (uint32_t i = 0; i < queue->waiting_count_send - 1; i++) {
-                queue->waiting_tasks_send[i] = queue->waiting_tasks_send[i + 1];
-            }
-            queue->waiting_count_send--;
-
-            resume_task(task_to_wake);
-        }
+    if (queue->recv_loaned) {
+        enable_interrupts();
+        return QUEUE_BUSY;
+    }
 
-        notify_queue_event(queue, QUEUE_NOTIFY_ON_RECEIVE);
+    if (!queue_is_empty(queue)) {
+        take_from_queue(queue, buffer);
 
         enable_interrupts();
         return QUEUE_OK;
@@ -235,31 +475,42 @@ QueueStatus queue_receive(Queue* queue, void* buffer, uint32_t timeout) {
         return QUEUE_EMPTY;
     }
 
-    // Add current task to receiving waiting list
-    uint32_t current_task = get_current_task_id();
-    queue->waiting_tasks_recv[queue->waiting_count_recv++] = current_task;
+    // Add current task to receiving waiting list, the next sender copies
+    // its item straight into buffer and completes the receive for us
+    QueueStatus status = QUEUE_OK;
+    if (!wait_on_queue(queue, &queue->recv_waiters, buffer, timeout)) {
+        // Woken by a committed loan rather than a handoff
+        if (!queue_is_empty(queue) && !queue->recv_loaned) {
+            take_from_queue(queue, buffer);
+        } else {
+            status = QUEUE_TIMEOUT;
+        }
+    }
 
     enable_interrupts();
-    block_task(timeout);
-
-    return queue_is_empty(queue) ? QUEUE_TIMEOUT : QUEUE_OK;
+    return status;
 }
 
-QueueStatus queue_receive_from_isr(Queue* queue, void* buffer) {
+QueueStatus queue_receive_from_isr(Queue* queue, void* buffer, bool* switch_required) {
     if (!queue || !buffer || !queue->is_isr_enabled) {
         return QUEUE_ERROR;
     }
 
-    if (!queue_is_empty(queue)) {
-        copy_from_queue(queue, buffer, queue->head);
-        queue->head = (queue->head + 1) % queue->queue_length;
-        queue->items_count--;
-        notify_queue_event(queue, QUEUE_NOTIFY_ON_RECEIVE);
-        return QUEUE_OK;
+    uint32_t prev = enter_critical_from_isr();
+    QueueStatus status = QUEUE_OK;
+
+    if (queue->recv_loaned) {
+        status = QUEUE_BUSY;
+    } else if (!queue_is_empty(queue)) {
+        take_from_queue(queue, buffer);
+        report_switch(switch_required);
+    } else {
+        queue->underflow_count++;
+        status = QUEUE_EMPTY;
     }
 
-    queue->underflow_count++;
-    return QUEUE_EMPTY;
+    exit_critical_from_isr(prev);
+    return status;
 }
 
 void queue_reset(Queue* queue) {
@@ -268,10 +519,18 @@ void queue_reset(Queue* queue) {
         queue->head = 0;
         queue->tail = 0;
         queue->items_count = 0;
-        queue->waiting_count_send = 0;
-        queue->waiting_count_recv = 0;
+        // Let blocked tasks re-check the now empty queue
+        waitq_wake_all(&queue->send_waiters);
+        waitq_wake_all(&queue->recv_waiters);
         queue->overflow_count = 0;
         queue->underflow_count = 0;
+        queue->send_loaned = false;
+        queue->recv_loaned = false;
+
+        // The set must not hand out the items we just discarded
+        if (queue->queue_set != NULL) {
+            queueset_purge(queue->queue_set, queue);
+        }
         enable_interrupts();
     }
 }
@@ -283,39 +542,49 @@ QueueStatus queue_send_to_front(Queue* queue, const void* item, uint32_t timeout
 
     disable_interrupts();
 
-    if (!queue_is_full(queue)) {
+    // Moving head would hand a borrowed slot out again
+    if (queue->send_loaned || queue->recv_loaned) {
+        enable_interrupts();
+        return QUEUE_BUSY;
+    }
+
+    if (queue_is_full(queue)) {
+        if (timeout == 0) {
+            queue->overflow_count++;
+            enable_interrupts();
+            return QUEUE_FULL;
+        }
+
+        // Add current task to sending waiting list. No handoff here, a
+        // receiver would refill at the back, so retry once woken.
+        wait_on_queue(queue, &queue->send_waiters, NULL, timeout);
+        if (queue_is_full(queue) || queue->send_loaned || queue->recv_loaned) {
+            enable_interrupts();
+            return QUEUE_TIMEOUT;
+        }
+    }
+
+    // A blocked receiver means the queue is empty, front and back are the same
+    if (!handoff_to_receiver(queue, item)) {
         // Adjust head pointer
         queue->head = (queue->head - 1 + queue->queue_length) % queue->queue_length;
         copy_to_queue(queue, item, queue->head);
         queue->items_count++;
+        stats_enqueued(queue, queue->head, 1);
 
         // Wake up one waiting receiver if any
-        if (queue->waiting_count_recv > 0) {
-            uint32_t task_to_wake = queue->waiting_tasks_recv[0];
-            queue->waiting_count_recv--;
-            resume_task(task_to_wake);
-        }
-
-        notify_queue_event(queue, QUEUE_NOTIFY_ON_SEND);
-
-        enable_interrupts();
-        return QUEUE_OK;
-    }
-
-    if (timeout == 0) {
-        queue->overflow_count++;
-        enable_interrupts();
-        return QUEUE_FULL;
+        wake_receiver(queue);
+        notify_queue_set(queue, 1);
     }
 
-    // Add current task to sending waiting list
-    uint32_t current_task = get_current_task_id();
-    queue->waiting_tasks_send[queue->waiting_count_send++] = current_task;
+    notify_queue_event(queue, QUEUE_NOTIFY_ON_SEND);
 
     enable_interrupts();
-    block_task(timeout);
+    return QUEUE_OK;
+}
 
-    return queue_is_full(queue) ? QUEUE_TIMEOUT : QUEUE_OK;
+QueueStatus queue_send_to_back(Queue* queue, const void* item, uint32_t timeout) {
+    return queue_send(queue, item, timeout);
 }
 
 QueueStatus queue_overwrite(Queue* queue, const void* item) {
@@ -325,24 +594,288 @@ QueueStatus queue_overwrite(Queue* queue, const void* item) {
 
     disable_interrupts();
 
+    if (queue->send_loaned || (queue->recv_loaned && queue_is_full(queue))) {
+        enable_interrupts();
+        return QUEUE_BUSY;
+    }
+
     if (queue_is_full(queue)) {
         // Overwrite oldest item
         copy_to_queue(queue, item, queue->head);
+        stats_enqueued(queue, queue->head, 1);
         queue->head = (queue->head + 1) % queue->queue_length;
         queue->tail = (queue->tail + 1) % queue->queue_length;
         queue->overflow_count++;
+        notify_queue_event(queue, QUEUE_NOTIFY_ON_SEND);
     } else {
-        copy_to_queue(queue, item, queue->tail);
-        queue->tail = (queue->tail + 1) % queue->queue_length;
-        queue->items_count++;
+        put_to_queue(queue, item);
+    }
+
+    enable_interrupts();
+    return QUEUE_OK;
+}
+
+QueueStatus queue_send_n(Queue* queue, const void* items, uint32_t count, uint32_t* sent, uint32_t timeout) {
+    if (sent) {
+        *sent = 0;
+    }
+
+    if (!queue || !items || count == 0) {
+        return QUEUE_ERROR;
+    }
+
+    disable_interrupts();
+
+    if (queue->send_loaned) {
+        enable_interrupts();
+        return QUEUE_BUSY;
+    }
+
+    uint32_t moved = send_batch(queue, items, count);
+
+    if (moved == 0) {
+        if (timeout == 0) {
+            queue->overflow_count++;
+            enable_interrupts();
+            return QUEUE_FULL;
+        }
+
+        // Wait for space, then move whatever fits
+        wait_on_queue(queue, &queue->send_waiters, NULL, timeout);
+        if (!queue->send_loaned) {
+            moved = send_batch(queue, items, count);
+        }
+    }
+
+    enable_interrupts();
+
+    if (sent) {
+        *sent = moved;
+    }
+    return moved > 0 ? QUEUE_OK : QUEUE_TIMEOUT;
+}
+
+QueueStatus queue_send_n_from_isr(Queue* queue, const void* items, uint32_t count, uint32_t* sent, bool* switch_required) {
+    if (sent) {
+        *sent = 0;
+    }
+
+    if (!queue || !items || count == 0 || !queue->is_isr_enabled) {
+        return QUEUE_ERROR;
+    }
+
+    uint32_t prev = enter_critical_from_isr();
+
+    if (queue->send_loaned) {
+        exit_critical_from_isr(prev);
+        return QUEUE_BUSY;
+    }
+
+    uint32_t moved = send_batch(queue, items, count);
+    if (moved == 0) {
+        queue->overflow_count++;
+    } else {
+        report_switch(switch_required);
+    }
+
+    exit_critical_from_isr(prev);
+
+    if (sent) {
+        *sent = moved;
+    }
+    return moved > 0 ? QUEUE_OK : QUEUE_FULL;
+}
+
+QueueStatus queue_receive_n(Queue* queue, void* items, uint32_t count, uint32_t* received, uint32_t timeout) {
+    if (received) {
+        *received = 0;
+    }
+
+    if (!queue || !items || count == 0) {
+        return QUEUE_ERROR;
+    }
+
+    disable_interrupts();
+
+    if (queue->recv_loaned) {
+        enable_interrupts();
+        return QUEUE_BUSY;
+    }
+
+    uint32_t moved = receive_batch(queue, items, count);
+
+    if (moved == 0) {
+        if (timeout == 0) {
+            queue->underflow_count++;
+            enable_interrupts();
+            return QUEUE_EMPTY;
+        }
+
+        // Single-item handoff can't fill a batch, wait and take what is there
+        wait_on_queue(queue, &queue->recv_waiters, NULL, timeout);
+        if (!queue->recv_loaned) {
+            moved = receive_batch(queue, items, count);
+        }
+    }
+
+    enable_interrupts();
+
+    if (received) {
+        *received = moved;
+    }
+    return moved > 0 ? QUEUE_OK : QUEUE_TIMEOUT;
+}
+
+QueueStatus queue_receive_n_from_isr(Queue* queue, void* items, uint32_t count, uint32_t* received, bool* switch_required) {
+    if (received) {
+        *received = 0;
+    }
+
+    if (!queue || !items || count == 0 || !queue->is_isr_enabled) {
+        return QUEUE_ERROR;
+    }
+
+    uint32_t prev = enter_critical_from_isr();
+
+    if (queue->recv_loaned) {
+        exit_critical_from_isr(prev);
+        return QUEUE_BUSY;
+    }
+
+    uint32_t moved = receive_batch(queue, items, count);
+    if (moved == 0) {
+        queue->underflow_count++;
+    } else {
+        report_switch(switch_required);
+    }
+
+    exit_critical_from_isr(prev);
+
+    if (received) {
+        *received = moved;
+    }
+    return moved > 0 ? QUEUE_OK : QUEUE_EMPTY;
+}
+
+QueueStatus queue_send_loan(Queue* queue, void** slot, uint32_t timeout) {
+    if (!queue || !slot) {
+        return QUEUE_ERROR;
+    }
+
+    disable_interrupts();
+
+    if (queue->send_loaned) {
+        enable_interrupts();
+        return QUEUE_BUSY;
+    }
+
+    if (queue_is_full(queue)) {
+        if (timeout == 0) {
+            queue->overflow_count++;
+            enable_interrupts();
+            return QUEUE_FULL;
+        }
+
+        // Add current task to sending waiting list
+        wait_on_queue(queue, &queue->send_waiters, NULL, timeout);
+        if (queue_is_full(queue) || queue->send_loaned) {
+            enable_interrupts();
+            return QUEUE_TIMEOUT;
+        }
+    }
+
+    // Lend the tail slot, nothing else can write there until commit
+    queue->send_loaned = true;
+    *slot = (uint8_t*)queue->buffer + (queue->tail * queue->item_size);
+
+    enable_interrupts();
+    return QUEUE_OK;
+}
+
+QueueStatus queue_send_commit(Queue* queue) {
+    if (!queue || !queue->send_loaned) {
+        return QUEUE_ERROR;
     }
 
+    disable_interrupts();
+
+    queue->items_count++;
+    stats_enqueued(queue, queue->tail, 1);
+    queue->tail = (queue->tail + 1) % queue->queue_length;
+    queue->send_loaned = false;
+
+    // Wake up one waiting receiver if any
+    wake_receiver(queue);
+    notify_queue_set(queue, 1);
+
     notify_queue_event(queue, QUEUE_NOTIFY_ON_SEND);
 
     enable_interrupts();
     return QUEUE_OK;
 }
 
+void queue_send_abort(Queue* queue) {
+    if (queue) {
+        queue->send_loaned = false;
+    }
+}
+
+QueueStatus queue_receive_loan(Queue* queue, const void** slot, uint32_t timeout) {
+    if (!queue || !slot) {
+        return QUEUE_ERROR;
+    }
+
+    disable_interrupts();
+
+    if (queue->recv_loaned) {
+        enable_interrupts();
+        return QUEUE_BUSY;
+    }
+
+    if (queue_is_empty(queue)) {
+        if (timeout == 0) {
+            queue->underflow_count++;
+            enable_interrupts();
+            return QUEUE_EMPTY;
+        }
+
+        // Add current task to receiving waiting list
+        wait_on_queue(queue, &queue->recv_waiters, NULL, timeout);
+        if (queue_is_empty(queue) || queue->recv_loaned) {
+            enable_interrupts();
+            return QUEUE_TIMEOUT;
+        }
+    }
+
+    // Lend the head slot, it stays counted so no sender can reuse it
+    queue->recv_loaned = true;
+    *slot = (const uint8_t*)queue->buffer + (queue->head * queue->item_size);
+
+    enable_interrupts();
+    return QUEUE_OK;
+}
+
+QueueStatus queue_receive_release(Queue* queue) {
+    if (!queue || !queue->recv_loaned) {
+        return QUEUE_ERROR;
+    }
+
+    disable_interrupts();
+
+    stats_dequeued(queue, queue->head, 1);
+    queue->head = (queue->head + 1) % queue->queue_length;
+    queue->items_count--;
+    queue->recv_loaned = false;
+
+    // Hand the freed slot to one waiting sender if any
+    refill_from_sender(queue);
+
+    notify_queue_event(queue, QUEUE_NOTIFY_ON_RECEIVE);
+
+    enable_interrupts();
+    return QUEUE_OK;
+}
+
 void queue_set_notification(Queue* queue, QueueCallback callback, void* context, QueueNotifyType type) {
     if (queue) {
         disable_interrupts();
@@ -357,6 +890,84 @@ uint32_t queue_get_space_available(const Queue* queue) {
     return queue ? (queue->queue_length - queue->items_count) : 0;
 }
 
+uint32_t queue_get_count(const Queue* queue) {
+    return queue ? queue->items_count : 0;
+}
+
+bool queue_is_full(const Queue* queue) {
+    return queue ? (queue->items_count == queue->queue_length) : true;
+}
+
+bool queue_is_empty(const Queue* queue) {
+    return queue ? (queue->items_count == 0) : true;
+}
+
+QueueStatus queue_peek(Queue* queue, void* buffer) {
+    if (!queue || !buffer) {
+        return QUEUE_ERROR;
+    }
+
+    disable_interrupts();
+
+    if (queue->recv_loaned) {
+        enable_interrupts();
+        return QUEUE_BUSY;
+    }
+
+    if (queue_is_empty(queue)) {
+        enable_interrupts();
+        return QUEUE_EMPTY;
+    }
+
+    copy_from_queue(queue, buffer, queue->head);
+
+    enable_interrupts();
+    return QUEUE_OK;
+}
+
+#if QUEUE_STATS_ENABLE
+void queue_get_stats(const Queue* queue, QueueStats* stats) {
+    if (!queue || !stats) {
+        return;
+    }
+
+    disable_interrupts();
+    *stats = queue->stats;
+    enable_interrupts();
+}
+
+void queue_reset_stats(Queue* queue) {
+    if (!queue) {
+        return;
+    }
+
+    disable_interrupts();
+    memset(&queue->stats, 0, sizeof(queue->stats));
+    queue->stats.high_water = queue->items_count;
+    queue->stats.window_start = get_system_ticks();
+    enable_interrupts();
+}
+
+// Items already queued are stamped with the current tick
+void queue_set_timestamp_buffer(Queue* queue, uint32_t* timestamps) {
+    if (!queue) {
+        return;
+    }
+
+    disable_interrupts();
+
+    queue->timestamps = timestamps;
+    if (timestamps != NULL) {
+        uint32_t now = get_system_ticks();
+        for (uint32_t i = 0; i < queue->queue_length; i++) {
+            timestamps[i] = now;
+        }
+    }
+
+    enable_interrupts();
+}
+#endif
+
 // Example usage:
 /*
 void example_queue_usage(void) {
@@ -0,0 +1,134 @@
+// queue.h
+#ifndef RTOS_QUEUE_H
+#define RTOS_QUEUE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "memory.h"
+#include "waitq.h"
+
+struct QueueSet;
+
+// Queue error codes
+typedef enum {
+    QUEUE_OK,
+    QUEUE_FULL,
+    QUEUE_EMPTY,
+    QUEUE_ERROR,
+    QUEUE_TIMEOUT,
+    QUEUE_BUSY                       // A slot on this side is on loan
+} QueueStatus;
+
+// Queue notification type
+typedef enum {
+    QUEUE_NOTIFY_ON_SEND,
+    QUEUE_NOTIFY_ON_RECEIVE,
+    QUEUE_NOTIFY_ON_FULL,
+    QUEUE_NOTIFY_ON_EMPTY
+} QueueNotifyType;
+
+// Queue notification callback
+typedef void (*QueueCallback)(void* queue, void* context);
+
+#if QUEUE_STATS_ENABLE
+// Per-queue counters. Every field is a uint32_t so a snapshot can be sent
+// to a host tool as-is. Latency is measured from enqueue to dequeue and
+// needs a timestamp per slot; items handed straight to a blocked receiver
+// count as zero latency.
+typedef struct {
+    uint32_t high_water;                          // Most items ever queued at once
+    uint32_t sent;                                // Items accepted
+    uint32_t received;                            // Items taken out
+    uint32_t throughput;                          // Items received per second, last full window
+    uint32_t send_blocked_ticks;                  // Total ticks senders spent blocked
+    uint32_t recv_blocked_ticks;                  // Total ticks receivers spent blocked
+    uint32_t max_latency;                         // Longest enqueue to dequeue time, in ticks
+    uint32_t latency[QUEUE_LATENCY_BUCKETS];      // Latency histogram, see rtos_config.h
+    uint32_t window_start;                        // Tick the throughput window opened
+    uint32_t window_count;                        // Items received in the current window
+} QueueStats;
+#endif
+
+// Queue structure
+typedef struct {
+    void* buffer;                     // Queue data buffer
+    uint32_t item_size;              // Size of each item
+    uint32_t queue_length;           // Maximum number of items
+    uint32_t items_count;            // Current number of items
+    uint32_t head;                   // Read index
+    uint32_t tail;                   // Write index
+    WaitQueue send_waiters;          // Tasks waiting to send
+    WaitQueue recv_waiters;          // Tasks waiting to receive
+    bool is_isr_enabled;             // ISR usage flag
+    QueueCallback notify_callback;    // Notification callback
+    void* notify_context;            // Notification context
+    QueueNotifyType notify_type;     // Notification type
+    uint32_t overflow_count;         // Number of overflow events
+    uint32_t underflow_count;        // Number of underflow events
+    bool is_static;                  // Storage supplied by the caller
+    bool send_loaned;                // Tail slot lent to a producer
+    bool recv_loaned;                // Head slot lent to a consumer
+    struct QueueSet* queue_set;      // Set told about new items, NULL if none
+#if QUEUE_STATS_ENABLE
+    uint32_t* timestamps;            // Enqueue tick per slot, NULL disables latency
+    QueueStats stats;                // Usage statistics
+#endif
+} Queue;
+
+// Compile-time initializer for a queue over caller-supplied storage:
+//   static uint8_t rx_storage[16 * sizeof(Frame)];
+//   static Queue rx_queue = QUEUE_STATIC_INIT(rx_storage, sizeof(Frame), 16);
+#define QUEUE_STATIC_INIT(storage, size, length) { \
+    .buffer = (storage),                           \
+    .item_size = (size),                           \
+    .queue_length = (length),                      \
+    .is_static = true                              \
+}
+
+// Queue functions. Timeout 0 never blocks, WAIT_FOREVER never expires.
+// The _from_isr variants set *switch_required (if not NULL) when they wake
+// a task that outranks the interrupted one, see yield_from_isr().
+QueueStatus queue_create(Queue** queue, uint32_t item_size, uint32_t queue_length);
+QueueStatus queue_create_static(Queue* queue, void* buffer, uint32_t item_size, uint32_t queue_length);
+void queue_delete(Queue* queue);
+QueueStatus queue_send(Queue* queue, const void* item, uint32_t timeout);
+QueueStatus queue_send_from_isr(Queue* queue, const void* item, bool* switch_required);
+QueueStatus queue_receive(Queue* queue, void* buffer, uint32_t timeout);
+QueueStatus queue_receive_from_isr(Queue* queue, void* buffer, bool* switch_required);
+QueueStatus queue_peek(Queue* queue, void* buffer);
+void queue_reset(Queue* queue);
+uint32_t queue_get_count(const Queue* queue);
+bool queue_is_full(const Queue* queue);
+bool queue_is_empty(const Queue* queue);
+void queue_set_notification(Queue* queue, QueueCallback callback, void* context, QueueNotifyType type);
+uint32_t queue_get_space_available(const Queue* queue);
+QueueStatus queue_send_to_front(Queue* queue, const void* item, uint32_t timeout);
+QueueStatus queue_send_to_back(Queue* queue, const void* item, uint32_t timeout);
+QueueStatus queue_overwrite(Queue* queue, const void* item);
+
+// Batch transfer: move up to count items in one critical section. Returns
+// QUEUE_OK if at least one item moved, the number moved goes to *sent or
+// *received. With a timeout, waits until at least one item can move.
+QueueStatus queue_send_n(Queue* queue, const void* items, uint32_t count, uint32_t* sent, uint32_t timeout);
+QueueStatus queue_send_n_from_isr(Queue* queue, const void* items, uint32_t count, uint32_t* sent, bool* switch_required);
+QueueStatus queue_receive_n(Queue* queue, void* items, uint32_t count, uint32_t* received, uint32_t timeout);
+QueueStatus queue_receive_n_from_isr(Queue* queue, void* items, uint32_t count, uint32_t* received, bool* switch_required);
+
+// Zero-copy access: borrow a slot in the queue buffer, fill or read it in
+// place, then commit or release it. One loan per side at a time; other
+// operations on a side with an outstanding loan return QUEUE_BUSY.
+QueueStatus queue_send_loan(Queue* queue, void** slot, uint32_t timeout);
+QueueStatus queue_send_commit(Queue* queue);
+void queue_send_abort(Queue* queue);
+QueueStatus queue_receive_loan(Queue* queue, const void** slot, uint32_t timeout);
+QueueStatus queue_receive_release(Queue* queue);
+
+#if QUEUE_STATS_ENABLE
+// Statistics. Dynamic queues get latency timestamps automatically, static
+// queues can supply a queue_length array of uint32_t for them.
+void queue_get_stats(const Queue* queue, QueueStats* stats);
+void queue_reset_stats(Queue* queue);
+void queue_set_timestamp_buffer(Queue* queue, uint32_t* timestamps);
+#endif
+
+#endif // RTOS_QUEUE_H
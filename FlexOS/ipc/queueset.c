@@ -0,0 +1,170 @@
+// queueset.c
+#include <stddef.h>
+#include "queueset.h"
+#include "scheduler.h"
+
+QueueStatus queueset_create(QueueSet** set, uint32_t length) {
+    if (!set || length == 0) {
+        return QUEUE_ERROR;
+    }
+
+    QueueSet* new_set = (QueueSet*)memory_alloc(sizeof(QueueSet));
+    if (!new_set) {
+        return QUEUE_ERROR;
+    }
+
+    void** storage = (void**)memory_alloc(length * sizeof(void*));
+    if (!storage) {
+        memory_free(new_set);
+        return QUEUE_ERROR;
+    }
+
+    queueset_create_static(new_set, storage, length);
+
+    // The ready queue is embedded, so the set owns its storage
+    new_set->ready.is_static = false;
+
+    *set = new_set;
+    return QUEUE_OK;
+}
+
+QueueStatus queueset_create_static(QueueSet* set, void** storage, uint32_t length) {
+    if (!set) {
+        return QUEUE_ERROR;
+    }
+
+    QueueStatus status = queue_create_static(&set->ready, storage, sizeof(void*), length);
+    if (status == QUEUE_OK) {
+        // Members post from whatever context they are signalled in
+        set->ready.is_isr_enabled = true;
+    }
+
+    return status;
+}
+
+void queueset_delete(QueueSet* set) {
+    if (set && !set->ready.is_static) {
+        memory_free(set->ready.buffer);
+        memory_free(set);
+    }
+}
+
+QueueStatus queueset_add_queue(QueueSet* set, Queue* queue) {
+    if (!set || !queue) {
+        return QUEUE_ERROR;
+    }
+
+    disable_interrupts();
+
+    if (queue->queue_set != NULL || !queue_is_empty(queue)) {
+        enable_interrupts();
+        return QUEUE_ERROR;
+    }
+
+    queue->queue_set = set;
+
+    enable_interrupts();
+    return QUEUE_OK;
+}
+
+QueueStatus queueset_remove_queue(QueueSet* set, Queue* queue) {
+    if (!set || !queue) {
+        return QUEUE_ERROR;
+    }
+
+    disable_interrupts();
+
+    // A non-empty member still has handles queued in the set
+    if (queue->queue_set != set || !queue_is_empty(queue)) {
+        enable_interrupts();
+        return QUEUE_ERROR;
+    }
+
+    queue->queue_set = NULL;
+
+    enable_interrupts();
+    return QUEUE_OK;
+}
+
+QueueStatus queueset_add_semaphore(QueueSet* set, Semaphore* sem) {
+    if (!set || !sem) {
+        return QUEUE_ERROR;
+    }
+
+    disable_interrupts();
+
+    if (sem->queue_set != NULL || sem_get_count(sem) != 0) {
+        enable_interrupts();
+        return QUEUE_ERROR;
+    }
+
+    sem->queue_set = set;
+
+    enable_interrupts();
+    return QUEUE_OK;
+}
+
+QueueStatus queueset_remove_semaphore(QueueSet* set, Semaphore* sem) {
+    if (!set || !sem) {
+        return QUEUE_ERROR;
+    }
+
+    disable_interrupts();
+
+    if (sem->queue_set != set || sem_get_count(sem) != 0) {
+        enable_interrupts();
+        return QUEUE_ERROR;
+    }
+
+    sem->queue_set = NULL;
+
+    enable_interrupts();
+    return QUEUE_OK;
+}
+
+void* queueset_select(QueueSet* set, uint32_t timeout) {
+    void* member = NULL;
+
+    if (!set || queue_receive(&set->ready, &member, timeout) != QUEUE_OK) {
+        return NULL;
+    }
+
+    return member;
+}
+
+void* queueset_select_from_isr(QueueSet* set) {
+    void* member = NULL;
+
+    if (!set || queue_receive_from_isr(&set->ready, &member, NULL) != QUEUE_OK) {
+        return NULL;
+    }
+
+    return member;
+}
+
+void queueset_notify(QueueSet* set, void* member) {
+    // Fails only if the set is smaller than its members, counted as overflow
+    queue_send_from_isr(&set->ready, &member, NULL);
+}
+
+// Drop every handle of member from the ready ring, keeping the order of
+// the rest. Used when a member is emptied without going through select.
+void queueset_purge(QueueSet* set, const void* member) {
+    Queue* ready = &set->ready;
+    void** slots = (void**)ready->buffer;
+    uint32_t read = ready->head;
+    uint32_t write = ready->head;
+    uint32_t kept = 0;
+
+    for (uint32_t i = 0; i < ready->items_count; i++) {
+        if (slots[read] != member) {
+            slots[write] = slots[read];
+            write = (write + 1) % ready->queue_length;
+            kept++;
+        }
+        read = (read + 1) % ready->queue_length;
+    }
+
+    ready->items_count = kept;
+    ready->tail = write;
+}
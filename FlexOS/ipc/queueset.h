@@ -0,0 +1,37 @@
+// queueset.h
+#ifndef RTOS_QUEUESET_H
+#define RTOS_QUEUESET_H
+
+#include "queue.h"
+#include "semaphore.h"
+
+// Lets one task block on several queues and semaphores at once. Every
+// item queued to a member and every unclaimed semaphore signal posts the
+// member's handle to the set, so select returns members in the order they
+// became ready. After select the caller takes from that member without
+// blocking. Size the set for the combined capacity of its members, and
+// only read members through select.
+typedef struct QueueSet {
+    Queue ready;                     // Handles of ready members, one per item
+} QueueSet;
+
+QueueStatus queueset_create(QueueSet** set, uint32_t length);
+QueueStatus queueset_create_static(QueueSet* set, void** storage, uint32_t length);
+void queueset_delete(QueueSet* set);
+
+// Members must be empty and not in another set when added or removed
+QueueStatus queueset_add_queue(QueueSet* set, Queue* queue);
+QueueStatus queueset_remove_queue(QueueSet* set, Queue* queue);
+QueueStatus queueset_add_semaphore(QueueSet* set, Semaphore* sem);
+QueueStatus queueset_remove_semaphore(QueueSet* set, Semaphore* sem);
+
+// Wait for a member to become ready, returns its handle or NULL on timeout.
+// The timeout works as for queue_receive().
+void* queueset_select(QueueSet* set, uint32_t timeout);
+void* queueset_select_from_isr(QueueSet* set);
+
+// Called by member objects with interrupts disabled
+void queueset_notify(QueueSet* set, void* member);
+void queueset_purge(QueueSet* set, const void* member);
+
+#endif // RTOS_QUEUESET_H
@@ -0,0 +1,139 @@
+// ringbuf.c
+#include "ringbuf.h"
+#include <string.h>
+
+// Order buffer accesses against the index update that publishes them
+#define RINGBUF_BARRIER() __sync_synchronize()
+
+bool ringbuf_init(RingBuffer* rb, uint8_t* storage, uint32_t capacity) {
+    if (!rb || !storage || capacity == 0 || (capacity & (capacity - 1)) != 0) {
+        return false;
+    }
+
+    rb->buffer = storage;
+    rb->mask = capacity - 1;
+    rb->write_count = 0;
+    rb->read_count = 0;
+    return true;
+}
+
+// Only safe while neither side is active
+void ringbuf_reset(RingBuffer* rb) {
+    if (rb) {
+        rb->write_count = 0;
+        rb->read_count = 0;
+    }
+}
+
+uint32_t ringbuf_get_count(const RingBuffer* rb) {
+    return rb ? (rb->write_count - rb->read_count) : 0;
+}
+
+uint32_t ringbuf_get_space(const RingBuffer* rb) {
+    return rb ? (rb->mask + 1) - (rb->write_count - rb->read_count) : 0;
+}
+
+bool ringbuf_put(RingBuffer* rb, uint8_t byte) {
+    uint32_t write_count = rb->write_count;
+
+    if (write_count - rb->read_count > rb->mask) {
+        return false;  // Full
+    }
+
+    rb->buffer[write_count & rb->mask] = byte;
+    RINGBUF_BARRIER();
+    rb->write_count = write_count + 1;
+    return true;
+}
+
+uint32_t ringbuf_write(RingBuffer* rb, const void* data, uint32_t length) {
+    uint32_t write_count = rb->write_count;
+    uint32_t space = (rb->mask + 1) - (write_count - rb->read_count);
+
+    if (length > space) {
+        length = space;
+    }
+
+    // At most two copies: up to the end of the storage, then from the start
+    uint32_t offset = write_count & rb->mask;
+    uint32_t first = rb->mask + 1 - offset;
+    if (first > length) {
+        first = length;
+    }
+
+    memcpy(rb->buffer + offset, data, first);
+    memcpy(rb->buffer, (const uint8_t*)data + first, length - first);
+
+    RINGBUF_BARRIER();
+    rb->write_count = write_count + length;
+    return length;
+}
+
+uint32_t ringbuf_write_span(RingBuffer* rb, uint8_t** span) {
+    uint32_t write_count = rb->write_count;
+    uint32_t space = (rb->mask + 1) - (write_count - rb->read_count);
+    uint32_t offset = write_count & rb->mask;
+    uint32_t contiguous = rb->mask + 1 - offset;
+
+    *span = rb->buffer + offset;
+    return space < contiguous ? space : contiguous;
+}
+
+void ringbuf_write_commit(RingBuffer* rb, uint32_t length) {
+    RINGBUF_BARRIER();
+    rb->write_count += length;
+}
+
+bool ringbuf_get(RingBuffer* rb, uint8_t* byte) {
+    uint32_t read_count = rb->read_count;
+
+    if (rb->write_count == read_count) {
+        return false;  // Empty
+    }
+
+    RINGBUF_BARRIER();
+    *byte = rb->buffer[read_count & rb->mask];
+    RINGBUF_BARRIER();
+    rb->read_count = read_count + 1;
+    return true;
+}
+
+uint32_t ringbuf_read(RingBuffer* rb, void* data, uint32_t length) {
+    uint32_t read_count = rb->read_count;
+    uint32_t count = rb->write_count - read_count;
+
+    if (length > count) {
+        length = count;
+    }
+
+    RINGBUF_BARRIER();
+
+    uint32_t offset = read_count & rb->mask;
+    uint32_t first = rb->mask + 1 - offset;
+    if (first > length) {
+        first = length;
+    }
+
+    memcpy(data, rb->buffer + offset, first);
+    memcpy((uint8_t*)data + first, rb->buffer, length - first);
+
+    RINGBUF_BARRIER();
+    rb->read_count = read_count + length;
+    return length;
+}
+
+uint32_t ringbuf_read_span(RingBuffer* rb, const uint8_t** span) {
+    uint32_t read_count = rb->read_count;
+    uint32_t count = rb->write_count - read_count;
+    uint32_t offset = read_count & rb->mask;
+    uint32_t contiguous = rb->mask + 1 - offset;
+
+    RINGBUF_BARRIER();
+    *span = rb->buffer + offset;
+    return count < contiguous ? count : contiguous;
+}
+
+void ringbuf_read_release(RingBuffer* rb, uint32_t length) {
+    RINGBUF_BARRIER();
+    rb->read_count += length;
+}
@@ -0,0 +1,45 @@
+// ringbuf.h
+#ifndef RTOS_RINGBUF_H
+#define RTOS_RINGBUF_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Single-producer/single-consumer byte ring. The producer only writes
+// write_count and the consumer only writes read_count, so one side may
+// run in an ISR and the other in a task without any critical section.
+// The counts run freely and are masked on access, so the full capacity
+// is usable.
+typedef struct {
+    uint8_t* buffer;                 // Storage, capacity bytes
+    uint32_t mask;                   // Capacity - 1, capacity is a power of two
+    volatile uint32_t write_count;   // Total bytes written (producer owned)
+    volatile uint32_t read_count;    // Total bytes read (consumer owned)
+} RingBuffer;
+
+// Compile-time initializer, storage must be an array with a power-of-two size
+#define RINGBUF_STATIC_INIT(storage) { \
+    .buffer = (storage),               \
+    .mask = sizeof(storage) - 1,       \
+    .write_count = 0,                  \
+    .read_count = 0                    \
+}
+
+bool ringbuf_init(RingBuffer* rb, uint8_t* storage, uint32_t capacity);
+void ringbuf_reset(RingBuffer* rb);
+uint32_t ringbuf_get_count(const RingBuffer* rb);
+uint32_t ringbuf_get_space(const RingBuffer* rb);
+
+// Producer side
+bool ringbuf_put(RingBuffer* rb, uint8_t byte);
+uint32_t ringbuf_write(RingBuffer* rb, const void* data, uint32_t length);
+uint32_t ringbuf_write_span(RingBuffer* rb, uint8_t** span);
+void ringbuf_write_commit(RingBuffer* rb, uint32_t length);
+
+// Consumer side
+bool ringbuf_get(RingBuffer* rb, uint8_t* byte);
+uint32_t ringbuf_read(RingBuffer* rb, void* data, uint32_t length);
+uint32_t ringbuf_read_span(RingBuffer* rb, const uint8_t** span);
+void ringbuf_read_release(RingBuffer* rb, uint32_t length);
+
+#endif // RTOS_RINGBUF_H
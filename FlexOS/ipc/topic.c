@@ -0,0 +1,272 @@
+// topic.c
+#include <stddef.h>
+#include <string.h>
+#include "topic.h"
+#include "scheduler.h"
+
+#define TOPIC_ALIGNMENT 8u          // Sample payload alignment
+#define TOPIC_ALIGN(x)  (((x) + TOPIC_ALIGNMENT - 1) & ~(TOPIC_ALIGNMENT - 1))
+
+// Pool entry header, the sample data follows it
+typedef struct TopicSample {
+    struct TopicSample* next_free;   // Free list link
+    uint32_t refs;                   // Subscribers still holding the sample
+} TopicSample;
+
+#define TOPIC_HEADER_SIZE  TOPIC_ALIGN(sizeof(TopicSample))
+
+static inline TopicSample* sample_header(const void* sample) {
+    return (TopicSample*)((uint8_t*)sample - TOPIC_HEADER_SIZE);
+}
+
+static inline void* sample_data(TopicSample* header) {
+    return (uint8_t*)header + TOPIC_HEADER_SIZE;
+}
+
+// Called with interrupts disabled
+static void* pool_get(Topic* topic) {
+    TopicSample* header = (TopicSample*)topic->free_list;
+
+    if (header == NULL) {
+        return NULL;
+    }
+
+    topic->free_list = header->next_free;
+    header->refs = 0;
+    return sample_data(header);
+}
+
+// Drop one reference, called with interrupts disabled
+static void sample_put(Topic* topic, TopicSample* header) {
+    if (header->refs > 0 && --header->refs > 0) {
+        return;
+    }
+
+    header->next_free = (TopicSample*)topic->free_list;
+    topic->free_list = header;
+}
+
+// Queue a reference to sample for every subscriber, called with interrupts disabled
+static void deliver(Topic* topic, void* sample, bool* switch_required) {
+    TopicSample* header = sample_header(sample);
+
+    // The publisher's reference keeps the sample alive while it is fanned out
+    header->refs = 1;
+
+    for (TopicSubscriber* sub = topic->subscribers; sub != NULL; sub = sub->next) {
+        if (queue_is_full(&sub->queue)) {
+            sub->dropped++;
+
+            if (sub->policy == TOPIC_DROP_NEWEST) {
+                continue;
+            }
+
+            void* oldest;
+            if (queue_receive_from_isr(&sub->queue, &oldest, NULL) == QUEUE_OK) {
+                sample_put(topic, sample_header(oldest));
+            }
+        }
+
+        header->refs++;
+        if (queue_send_from_isr(&sub->queue, &sample, switch_required) != QUEUE_OK) {
+            header->refs--;
+        }
+    }
+
+    sample_put(topic, header);
+}
+
+TopicStatus topic_create(Topic** topic, uint32_t sample_size, uint32_t pool_count) {
+    if (!topic || sample_size == 0 || pool_count == 0) {
+        return TOPIC_ERROR;
+    }
+
+    Topic* new_topic = (Topic*)memory_alloc(sizeof(Topic));
+    if (!new_topic) {
+        return TOPIC_ERROR;
+    }
+
+    uint32_t stride = TOPIC_HEADER_SIZE + TOPIC_ALIGN(sample_size);
+    // The stride only keeps payloads aligned if the pool starts aligned
+    uint8_t* pool = (uint8_t*)memory_alloc_aligned(stride * pool_count, TOPIC_ALIGNMENT);
+    if (!pool) {
+        memory_free(new_topic);
+        return TOPIC_ERROR;
+    }
+
+    new_topic->pool = pool;
+    new_topic->sample_size = sample_size;
+    new_topic->stride = stride;
+    new_topic->free_list = NULL;
+    new_topic->subscribers = NULL;
+
+    // Build the free list so the first buffer is handed out first
+    for (uint32_t i = pool_count; i > 0; i--) {
+        TopicSample* header = (TopicSample*)(pool + (i - 1) * stride);
+        header->next_free = (TopicSample*)new_topic->free_list;
+        new_topic->free_list = header;
+    }
+
+    *topic = new_topic;
+    return TOPIC_OK;
+}
+
+// All subscribers must have unsubscribed first
+void topic_delete(Topic* topic) {
+    if (topic) {
+        memory_free(topic->pool);
+        memory_free(topic);
+    }
+}
+
+TopicStatus topic_subscribe(Topic* topic, TopicSubscriber** sub, uint32_t depth, TopicOverrunPolicy policy) {
+    if (!topic || !sub || depth == 0) {
+        return TOPIC_ERROR;
+    }
+
+    TopicSubscriber* new_sub = (TopicSubscriber*)memory_alloc(sizeof(TopicSubscriber));
+    if (!new_sub) {
+        return TOPIC_ERROR;
+    }
+
+    void* storage = memory_alloc(depth * sizeof(void*));
+    if (!storage) {
+        memory_free(new_sub);
+        return TOPIC_ERROR;
+    }
+
+    queue_create_static(&new_sub->queue, storage, sizeof(void*), depth);
+
+    // Publishing may happen from an ISR
+    new_sub->queue.is_isr_enabled = true;
+    new_sub->policy = policy;
+    new_sub->dropped = 0;
+    new_sub->topic = topic;
+
+    disable_interrupts();
+    new_sub->next = topic->subscribers;
+    topic->subscribers = new_sub;
+    enable_interrupts();
+
+    *sub = new_sub;
+    return TOPIC_OK;
+}
+
+TopicStatus topic_unsubscribe(TopicSubscriber* sub) {
+    if (!sub) {
+        return TOPIC_ERROR;
+    }
+
+    Topic* topic = sub->topic;
+
+    disable_interrupts();
+
+    // A blocked receiver would wake up in freed memory
+    if (!waitq_is_empty(&sub->queue.recv_waiters)) {
+        enable_interrupts();
+        return TOPIC_BUSY;
+    }
+
+    TopicSubscriber** link = &topic->subscribers;
+    while (*link != NULL && *link != sub) {
+        link = &(*link)->next;
+    }
+    if (*link == sub) {
+        *link = sub->next;
+    }
+
+    // Give back the samples nobody will read now
+    void* sample;
+    while (queue_receive_from_isr(&sub->queue, &sample, NULL) == QUEUE_OK) {
+        sample_put(topic, sample_header(sample));
+    }
+
+    enable_interrupts();
+
+    memory_free(sub->queue.buffer);
+    memory_free(sub);
+    return TOPIC_OK;
+}
+
+TopicStatus topic_loan(Topic* topic, void** sample) {
+    if (!topic || !sample) {
+        return TOPIC_ERROR;
+    }
+
+    disable_interrupts();
+    *sample = pool_get(topic);
+    enable_interrupts();
+
+    return *sample ? TOPIC_OK : TOPIC_NO_BUFFER;
+}
+
+TopicStatus topic_loan_from_isr(Topic* topic, void** sample) {
+    if (!topic || !sample) {
+        return TOPIC_ERROR;
+    }
+
+    // A task may be part way through a loan or release of the same pool
+    uint32_t prev = enter_critical_from_isr();
+    *sample = pool_get(topic);
+    exit_critical_from_isr(prev);
+
+    return *sample ? TOPIC_OK : TOPIC_NO_BUFFER;
+}
+
+void topic_publish(Topic* topic, void* sample) {
+    if (!topic || !sample) {
+        return;
+    }
+
+    disable_interrupts();
+    deliver(topic, sample, NULL);
+    enable_interrupts();
+}
+
+void topic_publish_from_isr(Topic* topic, void* sample, bool* switch_required) {
+    if (topic && sample) {
+        uint32_t prev = enter_critical_from_isr();
+        deliver(topic, sample, switch_required);
+        exit_critical_from_isr(prev);
+    }
+}
+
+TopicStatus topic_publish_copy(Topic* topic, const void* data) {
+    if (!data) {
+        return TOPIC_ERROR;
+    }
+
+    void* sample;
+    TopicStatus status = topic_loan(topic, &sample);
+    if (status == TOPIC_OK) {
+        memcpy(sample, data, topic->sample_size);
+        topic_publish(topic, sample);
+    }
+
+    return status;
+}
+
+TopicStatus topic_receive(TopicSubscriber* sub, const void** sample, uint32_t timeout) {
+    if (!sub || !sample) {
+        return TOPIC_ERROR;
+    }
+
+    void* received;
+    QueueStatus status = queue_receive(&sub->queue, &received, timeout);
+    if (status == QUEUE_OK) {
+        *sample = received;
+        return TOPIC_OK;
+    }
+
+    return (status == QUEUE_ERROR) ? TOPIC_ERROR : TOPIC_TIMEOUT;
+}
+
+void topic_release(Topic* topic, const void* sample) {
+    if (!topic || !sample) {
+        return;
+    }
+
+    disable_interrupts();
+    sample_put(topic, sample_header(sample));
+    enable_interrupts();
+}
@@ -0,0 +1,68 @@
+// topic.h
+#ifndef RTOS_TOPIC_H
+#define RTOS_TOPIC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "queue.h"
+
+// Topic error codes
+typedef enum {
+    TOPIC_OK,
+    TOPIC_ERROR,
+    TOPIC_NO_BUFFER,                 // Every sample buffer is in use
+    TOPIC_TIMEOUT,
+    TOPIC_BUSY                       // A task is still receiving on the subscription
+} TopicStatus;
+
+// What a subscriber does with a new sample when its queue is full
+typedef enum {
+    TOPIC_DROP_NEWEST,               // Keep the backlog, skip the new sample
+    TOPIC_DROP_OLDEST                // Release the oldest queued sample
+} TopicOverrunPolicy;
+
+struct Topic;
+
+// Each subscriber queues pointers to shared samples, never the data
+typedef struct TopicSubscriber {
+    Queue queue;                     // Pending sample pointers
+    TopicOverrunPolicy policy;       // Overrun handling
+    uint32_t dropped;                // Samples lost to overruns
+    struct Topic* topic;             // Topic subscribed to
+    struct TopicSubscriber* next;    // Next subscriber of the same topic
+} TopicSubscriber;
+
+// Publish/subscribe bus. A publisher fills a pooled sample buffer once and
+// every subscriber receives a reference to it, so fan-out costs one pointer
+// per subscriber whatever the sample size. A buffer returns to the pool
+// when the last subscriber releases it.
+typedef struct Topic {
+    uint8_t* pool;                   // Sample buffers, each behind a header
+    uint32_t sample_size;            // Payload bytes per sample
+    uint32_t stride;                 // Bytes per pool entry
+    void* free_list;                 // Unused sample buffers
+    TopicSubscriber* subscribers;    // Subscriber list
+} Topic;
+
+TopicStatus topic_create(Topic** topic, uint32_t sample_size, uint32_t pool_count);
+void topic_delete(Topic* topic);
+TopicStatus topic_subscribe(Topic* topic, TopicSubscriber** sub, uint32_t depth, TopicOverrunPolicy policy);
+// Fails with TOPIC_BUSY while a task is blocked in topic_receive() on sub
+TopicStatus topic_unsubscribe(TopicSubscriber* sub);
+
+// Publisher side: borrow a sample buffer, fill it, then publish it. A
+// loaned buffer must be published, publishing it to nobody frees it.
+// topic_publish_from_isr() sets *switch_required (if not NULL) when it
+// wakes a subscriber that outranks the interrupted task.
+TopicStatus topic_loan(Topic* topic, void** sample);
+TopicStatus topic_loan_from_isr(Topic* topic, void** sample);
+void topic_publish(Topic* topic, void* sample);
+void topic_publish_from_isr(Topic* topic, void* sample, bool* switch_required);
+TopicStatus topic_publish_copy(Topic* topic, const void* data);
+
+// Subscriber side: every received sample must be released exactly once.
+// The timeout works as for queue_receive().
+TopicStatus topic_receive(TopicSubscriber* sub, const void** sample, uint32_t timeout);
+void topic_release(Topic* topic, const void* sample);
+
+#endif // RTOS_TOPIC_H
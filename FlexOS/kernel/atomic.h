@@ -0,0 +1,49 @@
+/* atomic.h */
+#ifndef ATOMIC_H
+#define ATOMIC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Compare-and-swap for the lock-free fast paths. Used without masking
+// interrupts, so slow paths that run with interrupts disabled may still
+// update the same words with plain stores.
+
+#if defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__)
+#include "cmsis_gcc.h"
+
+#define ATOMIC_COMPILER_BARRIER()  __COMPILER_BARRIER()
+
+// Any exception between LDREX and STREX clears the exclusive monitor, so
+// the store fails and the comparison is redone on fresh data
+static inline bool atomic_cas_u32(volatile uint32_t* ptr, uint32_t expected, uint32_t desired) {
+    do {
+        if (__LDREXW(ptr) != expected) {
+            __CLREX();
+            return false;
+        }
+    } while (__STREXW(desired, ptr) != 0);
+
+    __DMB();
+    return true;
+}
+
+static inline bool atomic_cas_word(volatile uintptr_t* ptr, uintptr_t expected, uintptr_t desired) {
+    return atomic_cas_u32((volatile uint32_t*)ptr, (uint32_t)expected, (uint32_t)desired);
+}
+
+#else
+// Host port: the C11 memory model builtins
+
+#define ATOMIC_COMPILER_BARRIER()  __atomic_signal_fence(__ATOMIC_SEQ_CST)
+
+static inline bool atomic_cas_u32(volatile uint32_t* ptr, uint32_t expected, uint32_t desired) {
+    return __atomic_compare_exchange_n(ptr, &expected, desired, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+static inline bool atomic_cas_word(volatile uintptr_t* ptr, uintptr_t expected, uintptr_t desired) {
+    return __atomic_compare_exchange_n(ptr, &expected, desired, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+#endif
+
+#endif /* ATOMIC_H */
@@ -11,6 +11,15 @@
 
 #include <stdint.h>
 #include "context.h"
+#include "rtos_config.h"
+#include "scheduler.h"
+
+#if KERNEL_USE_BASEPRI && KERNEL_SYSCALL_PRIORITY == 0
+#error "KERNEL_SYSCALL_PRIORITY must be above 0, BASEPRI 0 masks nothing"
+#endif
+
+/* BASEPRI value masking every level from KERNEL_SYSCALL_PRIORITY down */
+#define KERNEL_BASEPRI (KERNEL_SYSCALL_PRIORITY << (8 - KERNEL_PRIORITY_BITS))
 
 /* Assembly functions declared in context_asm.s */
 extern void PendSV_Handler(void);
@@ -98,6 +107,85 @@ void trigger_context_switch(void) {
     *(uint32_t volatile *)0xE000ED04 = 0x10000000;
 }
 
+/**
+ * @brief Enter a kernel critical section
+ * 
+ * Raises BASEPRI so only interrupts allowed to call the kernel are
+ * held off. Interrupts more urgent than KERNEL_SYSCALL_PRIORITY keep
+ * running, which is why they must never call kernel APIs.
+ */
+void disable_interrupts(void) {
+#if KERNEL_USE_BASEPRI
+    __set_BASEPRI(KERNEL_BASEPRI);
+    __ISB();
+#else
+    __disable_irq();
+#endif
+}
+
+/**
+ * @brief Leave a kernel critical section
+ */
+void enable_interrupts(void) {
+#if KERNEL_USE_BASEPRI
+    __set_BASEPRI(0);
+#else
+    __enable_irq();
+#endif
+}
+
+/**
+ * @brief Enter a critical section from an ISR
+ * 
+ * Kernel-aware interrupts at different levels can preempt each other,
+ * so the previous mask is returned for exit_critical_from_isr() rather
+ * than cleared. BASEPRI_MAX only ever raises the masking level.
+ * 
+ * @return uint32_t Mask in force on entry
+ */
+uint32_t enter_critical_from_isr(void) {
+#if KERNEL_USE_BASEPRI
+    uint32_t prev = __get_BASEPRI();
+    __set_BASEPRI_MAX(KERNEL_BASEPRI);
+    __ISB();
+#else
+    uint32_t prev = __get_PRIMASK();
+    __disable_irq();
+#endif
+    return prev;
+}
+
+/**
+ * @brief Leave a critical section entered from an ISR
+ * @param prev Mask returned by enter_critical_from_isr()
+ */
+void exit_critical_from_isr(uint32_t prev) {
+#if KERNEL_USE_BASEPRI
+    __set_BASEPRI(prev);
+#else
+    __set_PRIMASK(prev);
+#endif
+}
+
+/**
+ * @brief Check whether the CPU is in handler mode
+ * 
+ * IPSR holds the active exception number, 0 in thread mode.
+ */
+bool in_isr(void) {
+    return __get_IPSR() != 0;
+}
+
+/**
+ * @brief Read the free-running CPU cycle counter
+ * 
+ * DWT CYCCNT, started by context_init(). Wraps every 2^32 cycles, so
+ * only differences between readings are meaningful.
+ */
+uint32_t get_cycle_count(void) {
+    return DWT->CYCCNT;
+}
+
 /**
  * @brief Initialize context switching system
  * 
@@ -107,19 +195,24 @@ void trigger_context_switch(void) {
  * - Initial task setup
  */
 void context_init(void) {
-    /* Disable all interrupts */
-    __asm volatile ("cpsid i");
+    /* Hold off kernel-aware interrupts only */
+    disable_interrupts();
     
     /* Initialize system timer for tick interrupts */
     SysTick->LOAD = (SystemCoreClock / 1000) - 1;  /* 1ms tick */
     SysTick->VAL = 0;
     SysTick->CTRL = 0x07;  /* Enable, interrupt, use CPU clock */
     
-    /* Set PendSV to lowest priority */
-    NVIC_SetPriority(PendSV_IRQn, 0xFF);
+    /* Start the cycle counter used for profiling */
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    
+    /* Tick and context switch run at the least urgent kernel level */
+    NVIC_SetPriority(PendSV_IRQn, KERNEL_INTERRUPT_PRIORITY);
+    NVIC_SetPriority(SysTick_IRQn, KERNEL_INTERRUPT_PRIORITY);
     
-    /* Enable interrupts */
-    __asm volatile ("cpsie i");
+    enable_interrupts();
 }
 
 /**
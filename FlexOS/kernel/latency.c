@@ -0,0 +1,131 @@
+#include <stddef.h>
+#include "stm32f4xx.h"
+#include "rtos_config.h"
+#include "latency.h"
+#include "queue.h"
+
+#if LATENCY_BENCH_ENABLE
+
+#define TRAFFIC_QUEUE_LENGTH 16
+#define TRAFFIC_BATCH        8
+
+static volatile LatencyStats bench;
+static uint32_t cycles_per_tick;
+
+static Queue traffic_queue;
+static uint32_t traffic_storage[TRAFFIC_QUEUE_LENGTH];
+static bool traffic_ready;
+
+// TIM7 sits on APB1 and runs at twice PCLK1 whenever APB1 is divided
+static uint32_t timer_clock(void) {
+    uint32_t ppre1 = (RCC->CFGR & RCC_CFGR_PPRE1) >> RCC_CFGR_PPRE1_Pos;
+
+    if (ppre1 < 4) {
+        return SystemCoreClock;
+    }
+    return (SystemCoreClock >> (ppre1 - 3)) * 2;
+}
+
+void latency_bench_reset(void) {
+    NVIC_DisableIRQ(TIM7_IRQn);
+    bench.samples = 0;
+    bench.min_cycles = UINT32_MAX;
+    bench.max_cycles = 0;
+    bench.total_cycles = 0;
+    if (TIM7->CR1 & TIM_CR1_CEN) {
+        NVIC_EnableIRQ(TIM7_IRQn);
+    }
+}
+
+void latency_bench_start(uint32_t period_us) {
+    uint32_t clock = timer_clock();
+    uint32_t reload = (clock / 1000000) * period_us;
+
+    // TIM7 is a 16-bit counter
+    if (reload == 0 || reload > 0x10000) {
+        reload = 0x10000;
+    }
+
+    if (!traffic_ready) {
+        queue_create_static(&traffic_queue, traffic_storage, sizeof(uint32_t), TRAFFIC_QUEUE_LENGTH);
+        traffic_ready = true;
+    }
+
+    cycles_per_tick = SystemCoreClock / clock;
+
+    RCC->APB1ENR |= RCC_APB1ENR_TIM7EN;
+    (void)RCC->APB1ENR;
+
+    TIM7->CR1 = 0;
+    TIM7->PSC = 0;
+    TIM7->ARR = reload - 1;
+    TIM7->EGR = TIM_EGR_UG;
+    TIM7->SR = 0;
+    TIM7->DIER = TIM_DIER_UIE;
+
+    // Above KERNEL_SYSCALL_PRIORITY, so kernel critical sections never hold it off
+    NVIC_SetPriority(TIM7_IRQn, 0);
+    latency_bench_reset();
+    TIM7->CR1 = TIM_CR1_CEN;
+    NVIC_EnableIRQ(TIM7_IRQn);
+}
+
+void latency_bench_stop(void) {
+    TIM7->CR1 = 0;
+    NVIC_DisableIRQ(TIM7_IRQn);
+}
+
+void latency_bench_get(LatencyStats* stats) {
+    if (!stats) {
+        return;
+    }
+
+    NVIC_DisableIRQ(TIM7_IRQn);
+    stats->samples = bench.samples;
+    stats->min_cycles = bench.samples ? bench.min_cycles : 0;
+    stats->max_cycles = bench.max_cycles;
+    stats->total_cycles = bench.total_cycles;
+    if (TIM7->CR1 & TIM_CR1_CEN) {
+        NVIC_EnableIRQ(TIM7_IRQn);
+    }
+}
+
+void latency_bench_traffic(void* arg) {
+    uint32_t items[TRAFFIC_BATCH];
+    uint32_t seq = 0;
+    uint32_t done;
+
+    (void)arg;
+
+    while (1) {
+        for (uint32_t i = 0; i < TRAFFIC_BATCH; i++) {
+            items[i] = seq++;
+            queue_send(&traffic_queue, &items[i], 0);
+        }
+        for (uint32_t i = 0; i < TRAFFIC_BATCH; i++) {
+            queue_receive(&traffic_queue, &items[i], 0);
+        }
+
+        queue_send_n(&traffic_queue, items, TRAFFIC_BATCH, &done, 0);
+        queue_receive_n(&traffic_queue, items, TRAFFIC_BATCH, &done, 0);
+    }
+}
+
+// Must not call the kernel, it runs above KERNEL_SYSCALL_PRIORITY
+void TIM7_IRQHandler(void) {
+    // Counter restarted at the update event, so it holds the delay to here
+    uint32_t cycles = TIM7->CNT * cycles_per_tick;
+
+    TIM7->SR = ~TIM_SR_UIF;
+
+    bench.samples++;
+    bench.total_cycles += cycles;
+    if (cycles < bench.min_cycles) {
+        bench.min_cycles = cycles;
+    }
+    if (cycles > bench.max_cycles) {
+        bench.max_cycles = cycles;
+    }
+}
+
+#endif /* LATENCY_BENCH_ENABLE */
@@ -0,0 +1,27 @@
+/* latency.h */
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdint.h>
+
+// Entry latency of a level 0 interrupt, in CPU cycles. Includes the
+// fixed exception entry cost, so compare max against min rather than 0.
+typedef struct {
+    uint32_t samples;
+    uint32_t min_cycles;
+    uint32_t max_cycles;
+    uint64_t total_cycles;           // Sum of all samples, for the mean
+} LatencyStats;
+
+// Fires TIM7 every period_us at the most urgent level and records how
+// long after the update event its handler starts. Run it alongside
+// latency_bench_traffic tasks and compare KERNEL_USE_BASEPRI 0 and 1.
+void latency_bench_start(uint32_t period_us);
+void latency_bench_stop(void);
+void latency_bench_reset(void);
+void latency_bench_get(LatencyStats* stats);
+
+// Task body generating continuous queue traffic as background load
+void latency_bench_traffic(void* arg);
+
+#endif /* LATENCY_H */
@@ -1,41 +1,5 @@
-#include <stdint.h>
-#include <stdbool.h>
-
-#define MAX_TASKS 32
-#define STACK_SIZE 1024
-#define LOWEST_PRIORITY 0
-#define HIGHEST_PRIORITY 7
-
-// Task states
-typedef enum {
-    TASK_READY,
-    TASK_RUNNING,
-    TASK_BLOCKED,
-    TASK_SUSPENDED
-} TaskState;
-
-// Task Control Block (TCB)
-typedef struct {
-    uint32_t* stack_ptr;           // Current stack pointer
-    uint32_t stack[STACK_SIZE];    // Task stack
-    TaskState state;               // Current state
-    uint8_t priority;              // Task priority (0-7)
-    uint32_t time_slice;           // Time slice for round-robin
-    uint32_t blocked_timeout;      // Timeout for blocked state
-    void (*task_function)(void*);  // Task function pointer
-    void* arg;                     // Task argument
-    const char* name;              // Task name
-} TCB;
-
-// Scheduler data structure
-typedef struct {
-    TCB tasks[MAX_TASKS];          // Array of TCBs
-    uint32_t current_task;         // Index of current task
-    uint32_t next_task;           // Index of next task to run
-    uint32_t task_count;          // Number of tasks
-    bool scheduler_started;        // Scheduler state
-    uint32_t system_ticks;        // System tick counter
-} Scheduler;
+#include <stddef.h>
+#include "scheduler.h"
 
 // Global scheduler instance
 static Scheduler scheduler;
@@ -64,6 +28,7 @@ int32_t create_task(void (*task_func)(void*), void* arg, uint8_t priority, const
     // Initialize TCB
     task->state = TASK_READY;
     task->priority = priority;
+    task->base_priority = priority;
     task->time_slice = 0;
     task->blocked_timeout = 0;
     task->task_function = task_func;
@@ -98,6 +63,36 @@ static uint32_t find_next_task(void) {
     return next_task;
 }
 
+// Make the most urgent ready task current and pend the switch to it.
+// With preempt_only a running task keeps the CPU unless it is outranked.
+static void switch_to_next(bool preempt_only) {
+    // Find next task to run
+    scheduler.next_task = find_next_task();
+
+    // If current task is different from next task, perform context switch
+    if (scheduler.current_task != scheduler.next_task) {
+        TCB* current = &scheduler.tasks[scheduler.current_task];
+        TCB* next = &scheduler.tasks[scheduler.next_task];
+
+        if (preempt_only && current->state == TASK_RUNNING &&
+            next->priority <= current->priority) {
+            scheduler.next_task = scheduler.current_task;
+            return;
+        }
+
+        // Save current context and switch to next task
+        // This should trigger PendSV interrupt for context switching
+        if (current->state == TASK_RUNNING) {
+            current->state = TASK_READY;
+        }
+        next->state = TASK_RUNNING;
+        scheduler.current_task = scheduler.next_task;
+
+        // Trigger context switch (platform dependent)
+        trigger_context_switch();  // This function needs to be implemented
+    }
+}
+
 // Schedule next task
 void schedule(void) {
     if (!scheduler.scheduler_started || scheduler.task_count == 0) {
@@ -117,22 +112,26 @@ void schedule(void) {
         }
     }
 
-    // Find next task to run
-    scheduler.next_task = find_next_task();
+    switch_to_next(false);
+}
 
-    // If current task is different from next task, perform context switch
-    if (scheduler.current_task != scheduler.next_task) {
-        TCB* current = &scheduler.tasks[scheduler.current_task];
-        TCB* next = &scheduler.tasks[scheduler.next_task];
+// Request a switch to a ready task that outranks the running one. PendSV
+// only runs once every active interrupt has returned, so repeated requests
+// cost one switch.
+void request_context_switch(void) {
+    if (!scheduler.scheduler_started) {
+        return;
+    }
 
-        // Save current context and switch to next task
-        // This should trigger PendSV interrupt for context switching
-        current->state = TASK_READY;
-        next->state = TASK_RUNNING;
-        scheduler.current_task = scheduler.next_task;
+    disable_interrupts();
+    switch_to_next(true);
+    enable_interrupts();
+}
 
-        // Trigger context switch (platform dependent)
-        trigger_context_switch();  // This function needs to be implemented
+// Called once at ISR exit with the flag its _from_isr calls accumulated
+void yield_from_isr(bool switch_required) {
+    if (switch_required) {
+        request_context_switch();
     }
 }
 
@@ -178,3 +177,52 @@ void resume_task(uint32_t task_id) {
         scheduler.tasks[task_id].blocked_timeout = 0;
     }
 }
+
+// Make a blocked task ready again
+void unblock_task(TCB* task) {
+    if (task->state == TASK_BLOCKED) {
+        task->state = TASK_READY;
+        task->blocked_timeout = 0;
+    }
+}
+
+// Check whether a ready task has higher priority than task
+bool task_is_outranked(const TCB* task) {
+    for (uint32_t i = 0; i < scheduler.task_count; i++) {
+        if (scheduler.tasks[i].state == TASK_READY &&
+            scheduler.tasks[i].priority > task->priority) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Get the running task
+TCB* get_current_task(void) {
+    return &scheduler.tasks[scheduler.current_task];
+}
+
+// Get the running task's ID
+uint32_t get_current_task_id(void) {
+    return scheduler.current_task;
+}
+
+// Look up a task by ID
+TCB* get_task(uint32_t task_id) {
+    if (task_id >= scheduler.task_count) {
+        return NULL;
+    }
+
+    return &scheduler.tasks[task_id];
+}
+
+// Map a TCB back to its task ID
+uint32_t get_task_id(const TCB* task) {
+    return (uint32_t)(task - scheduler.tasks);
+}
+
+// Get system tick count
+uint32_t get_system_ticks(void) {
+    return scheduler.system_ticks;
+}
@@ -0,0 +1,42 @@
+/* scheduler.h */
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "rtos_types.h"
+
+// Critical sections, mask interrupts up to KERNEL_SYSCALL_PRIORITY only.
+// More urgent ISRs are never delayed and must not call the kernel.
+void disable_interrupts(void);
+void enable_interrupts(void);
+
+// Nestable variant for ISRs, which may preempt each other: restores the
+// mask that was in force on entry instead of unmasking everything
+uint32_t enter_critical_from_isr(void);
+void exit_critical_from_isr(uint32_t prev);
+
+// Task control
+TCB* get_current_task(void);
+uint32_t get_current_task_id(void);
+TCB* get_task(uint32_t task_id);
+uint32_t get_task_id(const TCB* task);
+void block_task(uint32_t timeout);
+void resume_task(uint32_t task_id);
+void unblock_task(TCB* task);
+bool task_is_outranked(const TCB* task);
+
+// Rescheduling. ISRs OR together the flags their _from_isr calls report
+// and call yield_from_isr() once on exit.
+void request_context_switch(void);
+void yield_from_isr(bool switch_required);
+
+// Time base
+uint32_t get_system_ticks(void);
+
+// Port layer (context.c)
+void trigger_context_switch(void);
+void init_system_timer(void);
+void start_first_task(void);
+uint32_t get_cycle_count(void);
+bool in_isr(void);
+
+#endif /* SCHEDULER_H */
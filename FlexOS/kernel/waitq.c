@@ -0,0 +1,124 @@
+/* waitq.c */
+#include <stddef.h>
+#include "waitq.h"
+#include "scheduler.h"
+
+void waitq_init(WaitQueue* wq) {
+    wq->head = NULL;
+    wq->tail = NULL;
+}
+
+// Insert behind all waiters of equal or higher priority
+void waitq_insert(WaitQueue* wq, TCB* task) {
+    TCB* after = wq->tail;
+
+    // Most waiters share a priority, so scan from the tail
+    while (after != NULL && after->priority < task->priority) {
+        after = after->prev;
+    }
+
+    task->prev = after;
+    if (after == NULL) {
+        task->next = wq->head;
+        wq->head = task;
+    } else {
+        task->next = after->next;
+        after->next = task;
+    }
+
+    if (task->next == NULL) {
+        wq->tail = task;
+    } else {
+        task->next->prev = task;
+    }
+
+    task->wait_queue = wq;
+}
+
+// Unlink a task from whichever wait queue holds it
+void waitq_remove(TCB* task) {
+    WaitQueue* wq = task->wait_queue;
+
+    if (wq == NULL) {
+        return;
+    }
+
+    if (task->prev == NULL) {
+        wq->head = task->next;
+    } else {
+        task->prev->next = task->next;
+    }
+
+    if (task->next == NULL) {
+        wq->tail = task->prev;
+    } else {
+        task->next->prev = task->prev;
+    }
+
+    task->next = NULL;
+    task->prev = NULL;
+    task->wait_queue = NULL;
+}
+
+// Change a task's priority, moving it to its new place if it is waiting
+void waitq_set_priority(TCB* task, uint8_t priority) {
+    WaitQueue* wq = task->wait_queue;
+
+    task->priority = priority;
+
+    if (wq != NULL) {
+        waitq_remove(task);
+        waitq_insert(wq, task);
+    }
+}
+
+TCB* waitq_pop(WaitQueue* wq) {
+    TCB* task = wq->head;
+
+    if (task != NULL) {
+        waitq_remove(task);
+    }
+
+    return task;
+}
+
+TCB* waitq_wake_one(WaitQueue* wq) {
+    TCB* task = waitq_pop(wq);
+
+    if (task != NULL) {
+        unblock_task(task);
+    }
+
+    return task;
+}
+
+uint32_t waitq_wake_all(WaitQueue* wq) {
+    uint32_t woken = 0;
+
+    while (waitq_wake_one(wq) != NULL) {
+        woken++;
+    }
+
+    return woken;
+}
+
+// Block the current task on wq. Returns true if a waker removed it from
+// the queue, false if it timed out (it is then unlinked here). Both 0 and
+// WAIT_FOREVER block without a timeout; callers decide what 0 means.
+bool waitq_block(WaitQueue* wq, uint32_t timeout) {
+    TCB* current = get_current_task();
+
+    waitq_insert(wq, current);
+
+    // The switch is pended and taken once interrupts are enabled again
+    block_task(timeout == WAIT_FOREVER ? 0 : timeout);
+    enable_interrupts();
+    disable_interrupts();
+
+    if (current->wait_queue != NULL) {
+        waitq_remove(current);
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,37 @@
+/* waitq.h */
+#ifndef WAITQ_H
+#define WAITQ_H
+
+#include "rtos_types.h"
+
+#define WAITQ_STATIC_INIT { .head = NULL, .tail = NULL }
+
+// All functions must be called with interrupts disabled
+void waitq_init(WaitQueue* wq);
+void waitq_insert(WaitQueue* wq, TCB* task);
+void waitq_remove(TCB* task);
+TCB* waitq_pop(WaitQueue* wq);
+TCB* waitq_wake_one(WaitQueue* wq);
+uint32_t waitq_wake_all(WaitQueue* wq);
+bool waitq_block(WaitQueue* wq, uint32_t timeout);
+void waitq_set_priority(TCB* task, uint8_t priority);
+
+static inline bool waitq_is_empty(const WaitQueue* wq) {
+    return wq->head == NULL;
+}
+
+static inline TCB* waitq_peek(const WaitQueue* wq) {
+    return wq->head;
+}
+
+// Ticks left of timeout after elapsed ticks, 0 once it has run out.
+// WAIT_FOREVER never runs out.
+static inline uint32_t waitq_remaining(uint32_t timeout, uint32_t elapsed) {
+    if (timeout == WAIT_FOREVER) {
+        return WAIT_FOREVER;
+    }
+
+    return elapsed < timeout ? timeout - elapsed : 0;
+}
+
+#endif /* WAITQ_H */
@@ -1,53 +1,238 @@
-
 /* memory.c */
 #include "memory.h"
+#include "scheduler.h"
+#include <string.h>
 
 // Memory block structure
 typedef struct MemoryBlock {
     size_t size;                 // Size of the block
     bool is_free;               // Is the block free?
+    bool dma_only;              // Allocated outside CCMRAM for DMA
+    uint8_t align_log2;         // Payload alignment requested, log2
     struct MemoryBlock* next;   // Next block in the list
 } MemoryBlock;
 
+#define MIN_SPLIT_SIZE 8        // Smallest payload worth splitting off as a free block
+
 // Memory pool
 static uint8_t heap[HEAP_SIZE];
+#if HEAP_CCM_SIZE > 0
+// NOLOAD, so the region costs no flash and no startup copy
+static uint8_t ccm_heap[HEAP_CCM_SIZE] __attribute__((section(".ccmbss"), aligned(4)));
+#endif
 static MemoryBlock* first_block;
 static size_t peak_usage = 0;
 static size_t current_usage = 0;
 
+// Incrementally maintained free-space metrics
+static size_t free_bytes = 0;
+static uint32_t free_block_count = 0;
+static size_t largest_free = 0;
+static bool largest_free_stale = false;     // Largest block was resized, exact again after the next alloc walk
+static uint32_t failed_allocs = 0;
+static uint32_t size_class_allocs[MEMORY_SIZE_CLASSES];
+
+#if MEMORY_TRACE_ENABLE
+static MemoryTraceRecord trace_buffer[MEMORY_TRACE_DEPTH];
+static uint32_t trace_head = 0;             // Next record to read
+static uint32_t trace_count = 0;            // Records buffered
+static uint32_t trace_dropped = 0;          // Records lost while buffer was full
+
+static void trace_event(MemoryTraceEvent event, void* caller, void* ptr, size_t size) {
+    if (trace_count == MEMORY_TRACE_DEPTH) {
+        trace_dropped++;
+        return;
+    }
+
+    MemoryTraceRecord* rec = &trace_buffer[(trace_head + trace_count) % MEMORY_TRACE_DEPTH];
+    rec->timestamp = get_system_ticks();
+    rec->caller = (uint32_t)(uintptr_t)caller;
+    rec->address = (uint32_t)(uintptr_t)ptr;
+    rec->size_event = ((uint32_t)size & 0x7FFFFFFFu) | ((uint32_t)event << 31);
+    trace_count++;
+}
+#endif
+
+#if MEMORY_CACHE_ENABLE
+#define CACHE_CLASS_SIZE(c)   ((size_t)16 << (c))
+
+// Cached blocks keep their heap header and link through the payload
+typedef struct CachedBlock {
+    struct CachedBlock* next;
+} CachedBlock;
+
+// Per-task free list for one size class, only touched by its owner task
+typedef struct {
+    CachedBlock* head;
+    uint32_t count;
+    uint32_t allocs;            // Allocations served from this cache
+} MemoryCache;
+
+static MemoryCache task_caches[MAX_TASKS][MEMORY_CACHE_CLASSES];
+#endif
+
+static inline MemoryBlock* block_of(void* ptr) {
+    return (MemoryBlock*)((uint8_t*)ptr - sizeof(MemoryBlock));
+}
+
+// Blocks from different regions are linked but never merged
+static inline bool blocks_adjacent(MemoryBlock* block, MemoryBlock* next) {
+    return (uint8_t*)(block + 1) + block->size == (uint8_t*)next;
+}
+
+// Padding in front of a block's payload to reach the alignment. A non-zero
+// gap must be able to hold a free block of its own in front of the payload.
+static size_t align_gap(MemoryBlock* block, size_t align) {
+    size_t gap = (size_t)(-(uintptr_t)(block + 1) & (align - 1));
+
+    while (gap != 0 && gap < sizeof(MemoryBlock) + MIN_SPLIT_SIZE) {
+        gap += align;
+    }
+
+    return gap;
+}
+
+// Rescan the block list for the largest free block
+static void refresh_largest_free(void) {
+    largest_free = 0;
+    for (MemoryBlock* current = first_block; current != NULL; current = current->next) {
+        if (current->is_free && current->size > largest_free) {
+            largest_free = current->size;
+        }
+    }
+    largest_free_stale = false;
+}
+
 void memory_init(void) {
     // Initialize first block
     first_block = (MemoryBlock*)heap;
     first_block->size = HEAP_SIZE - sizeof(MemoryBlock);
     first_block->is_free = true;
     first_block->next = NULL;
+
+    free_bytes = first_block->size;
+    free_block_count = 1;
+    largest_free = first_block->size;
+
+#if HEAP_CCM_SIZE > 0
+    // Second region, kept in address order with the main heap
+    MemoryBlock* ccm_block = (MemoryBlock*)ccm_heap;
+    ccm_block->size = HEAP_CCM_SIZE - sizeof(MemoryBlock);
+    ccm_block->is_free = true;
+
+    if ((uint8_t*)ccm_block < heap) {
+        ccm_block->next = first_block;
+        first_block = ccm_block;
+    } else {
+        ccm_block->next = NULL;
+        first_block->next = ccm_block;
+    }
+
+    free_bytes += ccm_block->size;
+    free_block_count++;
+    if (ccm_block->size > largest_free) {
+        largest_free = ccm_block->size;
+    }
+#endif
+
+    peak_usage = 0;
+    current_usage = 0;
+    largest_free_stale = false;
+    failed_allocs = 0;
+    memset(size_class_allocs, 0, sizeof(size_class_allocs));
+#if MEMORY_CACHE_ENABLE
+    memset(task_caches, 0, sizeof(task_caches));
+#endif
 }
 
-void* memory_alloc(size_t size) {
-    // Align size to 4 bytes
-    size = (size + 3) & ~3;
+uint32_t memory_size_class(size_t size) {
+    uint32_t size_class = 0;
+    size_t limit = 16;
+
+    while (size_class < MEMORY_SIZE_CLASSES - 1 && size > limit) {
+        limit <<= 1;
+        size_class++;
+    }
+
+    return size_class;
+}
+
+// Allocate from the shared heap, called with interrupts disabled.
+// align is a power of two >= 4, dma_only skips blocks in CCMRAM.
+static void* heap_alloc(size_t size, size_t align, bool dma_only) {
+    // Nothing large enough is free, skip the walk
+    if (!largest_free_stale && size > largest_free) {
+        failed_allocs++;
+        return NULL;
+    }
 
     MemoryBlock* current = first_block;
     MemoryBlock* best_fit = NULL;
-    size_t smallest_suitable_size = HEAP_SIZE;
+    size_t best_gap = 0;
+    size_t smallest_suitable_size = SIZE_MAX;
+
+    // The walk sees every free block, so track the two largest on the way
+    // to keep largest_free exact after the allocation
+    MemoryBlock* largest = NULL;
+    size_t runner_up = 0;
 
     // Find best fit block
     while (current != NULL) {
-        if (current->is_free && current->size >= size) {
-            if (current->size < smallest_suitable_size) {
+        if (current->is_free) {
+            if (largest == NULL || current->size > largest->size) {
+                runner_up = largest ? largest->size : 0;
+                largest = current;
+            } else if (current->size > runner_up) {
+                runner_up = current->size;
+            }
+        }
+
+        if (current->is_free && current->size >= size && current->size < smallest_suitable_size &&
+            (!dma_only || memory_is_dma_capable(current))) {
+            size_t gap = align_gap(current, align);
+            if (current->size >= gap + size) {
                 best_fit = current;
+                best_gap = gap;
                 smallest_suitable_size = current->size;
             }
         }
         current = current->next;
     }
 
+    largest_free = largest ? largest->size : 0;
+    largest_free_stale = false;
+
     if (best_fit == NULL) {
+        failed_allocs++;
         return NULL;  // No suitable block found
     }
 
+    // Without best_fit the largest is the runner-up, plus whatever is
+    // left of best_fit below
+    if (best_fit == largest) {
+        largest_free = runner_up;
+    }
+
+    // Leave the alignment padding behind as a free block
+    if (best_gap != 0) {
+        MemoryBlock* aligned = (MemoryBlock*)((uint8_t*)best_fit + best_gap);
+        aligned->size = best_fit->size - best_gap;
+        aligned->is_free = true;
+        aligned->next = best_fit->next;
+
+        best_fit->size = best_gap - sizeof(MemoryBlock);
+        best_fit->next = aligned;
+
+        free_bytes -= sizeof(MemoryBlock);
+        free_block_count++;
+        if (best_fit->size > largest_free) {
+            largest_free = best_fit->size;
+        }
+        best_fit = aligned;
+    }
+
     // Split block if it's too large
-    if (best_fit->size >= size + sizeof(MemoryBlock) + 8) {
+    if (best_fit->size >= size + sizeof(MemoryBlock) + MIN_SPLIT_SIZE) {
         MemoryBlock* new_block = (MemoryBlock*)((uint8_t*)best_fit + sizeof(MemoryBlock) + size);
         new_block->size = best_fit->size - size - sizeof(MemoryBlock);
         new_block->is_free = true;
@@ -55,28 +240,40 @@ void* memory_alloc(size_t size) {
 
         best_fit->size = size;
         best_fit->next = new_block;
+
+        free_bytes -= size + sizeof(MemoryBlock);
+        if (new_block->size > largest_free) {
+            largest_free = new_block->size;
+        }
+    } else {
+        free_bytes -= best_fit->size;
+        free_block_count--;
     }
 
     best_fit->is_free = false;
+    best_fit->dma_only = dma_only;
+    best_fit->align_log2 = (uint8_t)__builtin_ctz((unsigned)align);
     current_usage += best_fit->size;
     if (current_usage > peak_usage) {
         peak_usage = current_usage;
     }
 
-    return (void*)((uint8_t*)best_fit + sizeof(MemoryBlock));
+    return (void*)(best_fit + 1);
 }
 
-void memory_free(void* ptr) {
-    if (ptr == NULL) return;
-
-    MemoryBlock* block = (MemoryBlock*)((uint8_t*)ptr - sizeof(MemoryBlock));
+// Return a block to the shared heap, called with interrupts disabled
+static void heap_free(MemoryBlock* block) {
     block->is_free = true;
     current_usage -= block->size;
+    free_bytes += block->size;
+    free_block_count++;
 
     // Coalesce with next block if it's free
-    if (block->next != NULL && block->next->is_free) {
+    if (block->next != NULL && block->next->is_free && blocks_adjacent(block, block->next)) {
         block->size += block->next->size + sizeof(MemoryBlock);
         block->next = block->next->next;
+        free_bytes += sizeof(MemoryBlock);
+        free_block_count--;
     }
 
     // Find previous block to coalesce
@@ -85,28 +282,374 @@ void memory_free(void* ptr) {
         prev = prev->next;
     }
 
-    if (prev != NULL && prev->is_free) {
+    if (prev != NULL && prev->is_free && blocks_adjacent(prev, block)) {
         prev->size += block->size + sizeof(MemoryBlock);
         prev->next = block->next;
+        free_bytes += sizeof(MemoryBlock);
+        free_block_count--;
+        block = prev;
+    }
+
+    if (block->size > largest_free) {
+        largest_free = block->size;
     }
 }
 
-size_t memory_get_free_size(void) {
-    size_t free_size = 0;
-    MemoryBlock* current = first_block;
+// Grow or shrink an allocated block without moving it, called with
+// interrupts disabled. Fails only if growing needs more than the free
+// block that directly follows.
+static bool heap_resize(MemoryBlock* block, size_t size) {
+    MemoryBlock* next = block->next;
 
-    while (current != NULL) {
-        if (current->is_free) {
-            free_size += current->size;
+    if (size > block->size) {
+        if (next == NULL || !next->is_free || !blocks_adjacent(block, next) ||
+            block->size + sizeof(MemoryBlock) + next->size < size) {
+            return false;
         }
-        current = current->next;
+
+        if (next->size == largest_free) {
+            largest_free_stale = true;
+        }
+
+        // Absorb the following free block, header included
+        current_usage += next->size + sizeof(MemoryBlock);
+        free_bytes -= next->size;
+        free_block_count--;
+        block->size += next->size + sizeof(MemoryBlock);
+        block->next = next->next;
+    }
+
+    // Give the excess back as a free block
+    if (block->size >= size + sizeof(MemoryBlock) + MIN_SPLIT_SIZE) {
+        MemoryBlock* tail = (MemoryBlock*)((uint8_t*)(block + 1) + size);
+        tail->size = block->size - size - sizeof(MemoryBlock);
+        tail->is_free = true;
+        tail->next = block->next;
+
+        current_usage -= block->size - size;
+        free_bytes += tail->size;
+        free_block_count++;
+        block->size = size;
+        block->next = tail;
+
+        // Coalesce with next block if it's free
+        if (tail->next != NULL && tail->next->is_free && blocks_adjacent(tail, tail->next)) {
+            tail->size += tail->next->size + sizeof(MemoryBlock);
+            tail->next = tail->next->next;
+            free_bytes += sizeof(MemoryBlock);
+            free_block_count--;
+        }
+
+        if (tail->size > largest_free) {
+            largest_free = tail->size;
+        }
+    }
+
+    if (current_usage > peak_usage) {
+        peak_usage = current_usage;
+    }
+
+    return true;
+}
+
+// Heap path shared by the public allocators
+static void* locked_heap_alloc(size_t size, size_t align, bool dma_only, void* caller) {
+    disable_interrupts();
+    void* ptr = heap_alloc(size, align, dma_only);
+    if (ptr) {
+        size_class_allocs[memory_size_class(size)]++;
+#if MEMORY_TRACE_ENABLE
+        trace_event(MEMORY_TRACE_ALLOC, caller, ptr, block_of(ptr)->size);
+#endif
+    }
+    enable_interrupts();
+
+    (void)caller;
+    return ptr;
+}
+
+#if MEMORY_CACHE_ENABLE
+// Move half a cache's worth of blocks from the heap into an empty cache
+static void cache_refill(MemoryCache* cache, uint32_t size_class) {
+    for (uint32_t i = 0; i < MEMORY_CACHE_DEPTH / 2; i++) {
+        disable_interrupts();
+        CachedBlock* cached = (CachedBlock*)heap_alloc(CACHE_CLASS_SIZE(size_class), 4, false);
+        enable_interrupts();
+
+        if (cached == NULL) break;
+        cached->next = cache->head;
+        cache->head = cached;
+        cache->count++;
+    }
+}
+
+// Return blocks from a cache to the heap until only keep_count remain
+static void cache_drain(MemoryCache* cache, uint32_t keep_count) {
+    while (cache->count > keep_count) {
+        CachedBlock* cached = cache->head;
+        cache->head = cached->next;
+        cache->count--;
+
+        disable_interrupts();
+        heap_free(block_of(cached));
+        enable_interrupts();
+    }
+}
+
+static void* cache_alloc(uint32_t size_class) {
+    MemoryCache* cache = &task_caches[get_current_task_id()][size_class];
+
+    if (cache->head == NULL) {
+        cache_refill(cache, size_class);
+        if (cache->head == NULL) {
+            return NULL;
+        }
+    }
+
+    CachedBlock* cached = cache->head;
+    cache->head = cached->next;
+    cache->count--;
+    cache->allocs++;
+    return cached;
+}
+
+// Keep a freed block in the caller's cache if it is exactly a cached size
+static bool cache_free(MemoryBlock* block) {
+    uint32_t size_class = memory_size_class(block->size);
+
+    if (size_class >= MEMORY_CACHE_CLASSES || block->size != CACHE_CLASS_SIZE(size_class)) {
+        return false;
+    }
+
+    MemoryCache* cache = &task_caches[get_current_task_id()][size_class];
+    CachedBlock* cached = (CachedBlock*)(block + 1);
+    cached->next = cache->head;
+    cache->head = cached;
+    cache->count++;
+
+    if (cache->count > MEMORY_CACHE_DEPTH) {
+        cache_drain(cache, MEMORY_CACHE_DEPTH / 2);
+    }
+
+    return true;
+}
+#endif
+
+void* memory_alloc(size_t size) {
+    // Align size to 4 bytes
+    size = (size + 3) & ~3;
+
+#if MEMORY_CACHE_ENABLE
+    // The caches belong to tasks, an ISR would corrupt the interrupted one's
+    uint32_t size_class = memory_size_class(size);
+    if (size_class < MEMORY_CACHE_CLASSES && !in_isr()) {
+        void* ptr = cache_alloc(size_class);
+#if MEMORY_TRACE_ENABLE
+        if (ptr) {
+            disable_interrupts();
+            trace_event(MEMORY_TRACE_ALLOC, __builtin_return_address(0), ptr, CACHE_CLASS_SIZE(size_class));
+            enable_interrupts();
+        }
+#endif
+        return ptr;
+    }
+#endif
+
+    return locked_heap_alloc(size, 4, false, __builtin_return_address(0));
+}
+
+// Free path shared by memory_free and memory_realloc
+static void free_block(void* ptr, void* caller) {
+    MemoryBlock* block = block_of(ptr);
+
+#if MEMORY_TRACE_ENABLE
+    disable_interrupts();
+    trace_event(MEMORY_TRACE_FREE, caller, ptr, block->size);
+    enable_interrupts();
+#endif
+    (void)caller;
+
+#if MEMORY_CACHE_ENABLE
+    if (!in_isr() && cache_free(block)) {
+        return;
+    }
+#endif
+
+    disable_interrupts();
+    heap_free(block);
+    enable_interrupts();
+}
+
+void memory_free(void* ptr) {
+    if (ptr == NULL) return;
+
+    free_block(ptr, __builtin_return_address(0));
+}
+
+void* memory_realloc(void* ptr, size_t size) {
+    if (ptr == NULL) {
+        return locked_heap_alloc((size + 3) & ~3, 4, false, __builtin_return_address(0));
+    }
+
+    if (size == 0) {
+        free_block(ptr, __builtin_return_address(0));
+        return NULL;
+    }
+
+    MemoryBlock* block = block_of(ptr);
+    size_t old_size = block->size;
+    size_t align = (size_t)1 << block->align_log2;
+    bool dma_only = block->dma_only;
+
+    // Align size to 4 bytes, or whole granules as memory_alloc_dma() does
+    if (dma_only) {
+        size = (size + MEMORY_DMA_ALIGNMENT - 1) & ~(size_t)(MEMORY_DMA_ALIGNMENT - 1);
+    } else {
+        size = (size + 3) & ~3;
+    }
+
+    disable_interrupts();
+    if (heap_resize(block, size)) {
+#if MEMORY_TRACE_ENABLE
+        trace_event(MEMORY_TRACE_FREE, __builtin_return_address(0), ptr, old_size);
+        trace_event(MEMORY_TRACE_ALLOC, __builtin_return_address(0), ptr, block->size);
+#endif
+        enable_interrupts();
+        return ptr;
+    }
+    enable_interrupts();
+
+    // No room after the block, move it, keeping its alignment and region
+    void* new_ptr = locked_heap_alloc(size, align, dma_only, __builtin_return_address(0));
+    if (new_ptr == NULL) {
+        return NULL;  // Original block is left untouched
+    }
+
+    memcpy(new_ptr, ptr, old_size);
+    free_block(ptr, __builtin_return_address(0));
+
+    return new_ptr;
+}
+
+void* memory_alloc_aligned(size_t size, size_t align) {
+    // Alignment must be a power of two
+    if (align == 0 || (align & (align - 1)) != 0) {
+        return NULL;
     }
+    if (align < 4) {
+        align = 4;
+    }
+
+    // Align size to 4 bytes
+    size = (size + 3) & ~3;
+
+    return locked_heap_alloc(size, align, false, __builtin_return_address(0));
+}
+
+void* memory_alloc_dma(size_t size) {
+    // Round up to whole DMA granules so no other allocation shares one
+    size = (size + MEMORY_DMA_ALIGNMENT - 1) & ~(size_t)(MEMORY_DMA_ALIGNMENT - 1);
+
+    return locked_heap_alloc(size, MEMORY_DMA_ALIGNMENT, true, __builtin_return_address(0));
+}
 
-    return free_size;
+bool memory_is_dma_capable(const void* ptr) {
+    // The DMA controllers have no path to CCMRAM
+    uintptr_t addr = (uintptr_t)ptr;
+    return addr < CCMRAM_BASE || addr >= CCMRAM_BASE + CCMRAM_SIZE;
+}
+
+void* memory_alloc_from_isr(size_t size) {
+    // Align size to 4 bytes
+    size = (size + 3) & ~3;
+
+    return locked_heap_alloc(size, 4, false, __builtin_return_address(0));
+}
+
+void memory_free_from_isr(void* ptr) {
+    if (ptr == NULL) return;
+
+    MemoryBlock* block = block_of(ptr);
+
+    disable_interrupts();
+#if MEMORY_TRACE_ENABLE
+    trace_event(MEMORY_TRACE_FREE, __builtin_return_address(0), ptr, block->size);
+#endif
+    heap_free(block);
+    enable_interrupts();
+}
+
+void memory_cache_flush(void) {
+#if MEMORY_CACHE_ENABLE
+    uint32_t task_id = get_current_task_id();
+
+    for (uint32_t c = 0; c < MEMORY_CACHE_CLASSES; c++) {
+        cache_drain(&task_caches[task_id][c], 0);
+    }
+#endif
+}
+
+size_t memory_get_free_size(void) {
+    return free_bytes;
 }
 
 void memory_get_stats(size_t* total, size_t* used, size_t* peak) {
-    if (total) *total = HEAP_SIZE;
+    if (total) *total = HEAP_SIZE + HEAP_CCM_SIZE;
     if (used) *used = current_usage;
     if (peak) *peak = peak_usage;
 }
+
+void memory_get_detailed_stats(MemoryStats* stats) {
+    if (!stats) return;
+
+    disable_interrupts();
+
+    if (largest_free_stale) {
+        refresh_largest_free();
+    }
+
+    stats->total_size = HEAP_SIZE + HEAP_CCM_SIZE;
+    stats->used_size = current_usage;
+    stats->peak_size = peak_usage;
+    stats->free_size = free_bytes;
+    stats->largest_free_block = largest_free;
+    stats->free_block_count = free_block_count;
+    stats->fragmentation = free_bytes ? (uint32_t)(100 - (largest_free * 100) / free_bytes) : 0;
+    stats->failed_allocs = failed_allocs;
+    memcpy(stats->size_class_allocs, size_class_allocs, sizeof(size_class_allocs));
+
+    enable_interrupts();
+
+    stats->cached_size = 0;
+#if MEMORY_CACHE_ENABLE
+    // Per-task counters are owned by their tasks, a snapshot is good enough
+    for (uint32_t t = 0; t < MAX_TASKS; t++) {
+        for (uint32_t c = 0; c < MEMORY_CACHE_CLASSES; c++) {
+            stats->cached_size += task_caches[t][c].count * CACHE_CLASS_SIZE(c);
+            stats->size_class_allocs[c] += task_caches[t][c].allocs;
+        }
+    }
+#endif
+}
+
+#if MEMORY_TRACE_ENABLE
+uint32_t memory_trace_read(MemoryTraceRecord* records, uint32_t max_records) {
+    uint32_t copied = 0;
+
+    if (!records) return 0;
+
+    disable_interrupts();
+    while (copied < max_records && trace_count > 0) {
+        records[copied++] = trace_buffer[trace_head];
+        trace_head = (trace_head + 1) % MEMORY_TRACE_DEPTH;
+        trace_count--;
+    }
+    enable_interrupts();
+
+    return copied;
+}
+
+uint32_t memory_trace_get_dropped(void) {
+    return trace_dropped;
+}
+#endif
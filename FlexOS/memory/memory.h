@@ -4,12 +4,64 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <stdbool.h>
 #include "rtos_config.h"
 
+// Detailed heap statistics
+typedef struct {
+    size_t total_size;                               // Heap size in bytes
+    size_t used_size;                                // Bytes handed out to callers
+    size_t peak_size;                                // Highest used_size seen
+    size_t free_size;                                // Bytes in free blocks
+    size_t cached_size;                              // Used bytes parked in per-task caches
+    size_t largest_free_block;                       // Largest single free block
+    uint32_t free_block_count;                       // Number of free blocks
+    uint32_t fragmentation;                          // 0-100, 100 * (1 - largest / free)
+    uint32_t failed_allocs;                          // Allocations that returned NULL
+    uint32_t size_class_allocs[MEMORY_SIZE_CLASSES]; // Allocations per size class
+} MemoryStats;
+
+#if MEMORY_TRACE_ENABLE
+// Trace event types
+typedef enum {
+    MEMORY_TRACE_ALLOC,
+    MEMORY_TRACE_FREE
+} MemoryTraceEvent;
+
+// Binary trace record (16 bytes, little endian on target). A host tool
+// replays the ALLOC/FREE stream to rebuild the heap layout over time.
+typedef struct {
+    uint32_t timestamp;          // System tick of the event
+    uint32_t caller;             // Return address of the caller
+    uint32_t address;            // Payload address
+    uint32_t size_event;         // Bits 0-30: block size, bit 31: MemoryTraceEvent
+} MemoryTraceRecord;
+
+#define MEMORY_TRACE_SIZE(rec)   ((rec)->size_event & 0x7FFFFFFFu)
+#define MEMORY_TRACE_EVENT(rec)  ((MemoryTraceEvent)((rec)->size_event >> 31))
+#endif
+
 void memory_init(void);
+
+// Small blocks come from per-task caches. Called from an ISR these go
+// straight to the heap instead; the _from_isr variants always do.
 void* memory_alloc(size_t size);
 void memory_free(void* ptr);
+void* memory_realloc(void* ptr, size_t size);
+void* memory_alloc_aligned(size_t size, size_t align);
+void* memory_alloc_dma(size_t size);
+bool memory_is_dma_capable(const void* ptr);
+void* memory_alloc_from_isr(size_t size);
+void memory_free_from_isr(void* ptr);
+void memory_cache_flush(void);
 size_t memory_get_free_size(void);
 void memory_get_stats(size_t* total, size_t* used, size_t* peak);
+void memory_get_detailed_stats(MemoryStats* stats);
+uint32_t memory_size_class(size_t size);
+
+#if MEMORY_TRACE_ENABLE
+uint32_t memory_trace_read(MemoryTraceRecord* records, uint32_t max_records);
+uint32_t memory_trace_get_dropped(void);
+#endif
 
 #endif /* MEMORY_H */
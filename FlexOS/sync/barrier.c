@@ -0,0 +1,115 @@
+/* barrier.c */
+#include <stddef.h>
+#include "barrier.h"
+#include "scheduler.h"
+
+// What a task waiting for a partner offers, kept on its stack and found
+// through wait_buffer
+typedef struct {
+    void* give;
+    void* take;
+} RendezvousWait;
+
+bool barrier_init(Barrier* barrier, uint32_t parties) {
+    if (!barrier || parties == 0) {
+        return false;
+    }
+
+    barrier->parties = parties;
+    barrier->arrived = 0;
+    barrier->generation = 0;
+    waitq_init(&barrier->waiters);
+    return true;
+}
+
+bool barrier_wait(Barrier* barrier, uint32_t timeout, bool* last) {
+    if (last) {
+        *last = false;
+    }
+
+    disable_interrupts();
+
+    if (++barrier->arrived >= barrier->parties) {
+        // Last to arrive, release the whole generation at once
+        barrier->arrived = 0;
+        barrier->generation++;
+        waitq_wake_all(&barrier->waiters);
+        enable_interrupts();
+
+        if (last) {
+            *last = true;
+        }
+        return true;
+    }
+
+    if (timeout == 0) {
+        barrier->arrived--;
+        enable_interrupts();
+        return false;
+    }
+
+    TCB* current_task = get_current_task();
+    current_task->waiting_on = barrier;
+
+    bool released = waitq_block(&barrier->waiters, timeout);
+    current_task->waiting_on = NULL;
+
+    if (!released) {
+        // The round cannot have completed without us, so take back our arrival
+        barrier->arrived--;
+    }
+
+    enable_interrupts();
+    return released;
+}
+
+uint32_t barrier_get_generation(const Barrier* barrier) {
+    return barrier->generation;
+}
+
+void rendezvous_init(Rendezvous* rv) {
+    waitq_init(&rv->waiters);
+}
+
+bool rendezvous_exchange(Rendezvous* rv, void* give, void** take, uint32_t timeout) {
+    disable_interrupts();
+
+    // A partner is already waiting, swap with it and let it go
+    TCB* partner = waitq_pop(&rv->waiters);
+    if (partner != NULL) {
+        RendezvousWait* wait = (RendezvousWait*)partner->wait_buffer;
+        void* received = wait->give;
+
+        wait->take = give;
+        unblock_task(partner);
+        enable_interrupts();
+
+        if (take) {
+            *take = received;
+        }
+        return true;
+    }
+
+    if (timeout == 0) {
+        enable_interrupts();
+        return false;
+    }
+
+    // Wait for a partner, which fills in wait.take
+    TCB* current_task = get_current_task();
+    RendezvousWait wait = { .give = give, .take = NULL };
+
+    current_task->waiting_on = rv;
+    current_task->wait_buffer = &wait;
+
+    bool met = waitq_block(&rv->waiters, timeout);
+    current_task->waiting_on = NULL;
+    current_task->wait_buffer = NULL;
+
+    enable_interrupts();
+
+    if (met && take) {
+        *take = wait.take;
+    }
+    return met;
+}
@@ -0,0 +1,45 @@
+/* barrier.h */
+#ifndef BARRIER_H
+#define BARRIER_H
+
+#include "rtos_types.h"
+#include "waitq.h"
+
+// N tasks meet before any of them continues. The last one to arrive
+// releases the rest in a single pass and starts the next generation, so
+// the barrier can be reused straight away for the next frame.
+typedef struct {
+    uint32_t parties;              // Tasks that must arrive
+    uint32_t arrived;              // Tasks waiting in this generation
+    uint32_t generation;           // Completed rounds
+    WaitQueue waiters;
+} Barrier;
+
+#define BARRIER_STATIC_INIT(n) {             \
+    .parties = (n),                          \
+    .arrived = 0,                            \
+    .generation = 0,                         \
+    .waiters = WAITQ_STATIC_INIT             \
+}
+
+// Two tasks meet and swap one pointer. Further arrivals pair up in
+// priority order.
+typedef struct {
+    WaitQueue waiters;             // Tasks waiting for a partner
+} Rendezvous;
+
+#define RENDEZVOUS_STATIC_INIT { .waiters = WAITQ_STATIC_INIT }
+
+// Timeout 0 only succeeds for the last arrival, WAIT_FOREVER never
+// expires. A task that times out withdraws its arrival. *last (if not NULL) is set for the task that
+// completed the round, so exactly one task can do per-round work.
+bool barrier_init(Barrier* barrier, uint32_t parties);
+bool barrier_wait(Barrier* barrier, uint32_t timeout, bool* last);
+uint32_t barrier_get_generation(const Barrier* barrier);
+
+// Gives give to the partner and stores the partner's pointer in *take
+// (if not NULL)
+void rendezvous_init(Rendezvous* rv);
+bool rendezvous_exchange(Rendezvous* rv, void* give, void** take, uint32_t timeout);
+
+#endif /* BARRIER_H */
@@ -0,0 +1,133 @@
+/* events.c */
+#include <stddef.h>
+#include "events.h"
+#include "scheduler.h"
+
+// What a blocked task waits for, kept on its stack and found through wait_buffer
+typedef struct {
+    uint32_t bits;
+    uint8_t options;
+    uint32_t result;
+} EventWait;
+
+static bool wait_satisfied(uint32_t current, uint32_t bits, uint8_t options) {
+    if (options & EVENT_WAIT_ALL) {
+        return (current & bits) == bits;
+    }
+
+    return (current & bits) != 0;
+}
+
+// Wake every waiter the new bits satisfy in one walk of the wait queue,
+// then apply their clear-on-exit requests together. Called with
+// interrupts disabled.
+static uint32_t set_bits(EventGroup* group, uint32_t bits) {
+    uint32_t current = group->bits | bits;
+    uint32_t to_clear = 0;
+
+    TCB* task = waitq_peek(&group->waiters);
+    while (task != NULL) {
+        TCB* next = task->next;
+        EventWait* wait = (EventWait*)task->wait_buffer;
+
+        if (wait_satisfied(current, wait->bits, wait->options)) {
+            wait->result = current;
+            if (wait->options & EVENT_CLEAR_ON_EXIT) {
+                to_clear |= wait->bits;
+            }
+
+            waitq_remove(task);
+            unblock_task(task);
+        }
+
+        task = next;
+    }
+
+    current &= ~to_clear;
+    group->bits = current;
+    return current;
+}
+
+void event_group_init(EventGroup* group) {
+    group->bits = 0;
+    waitq_init(&group->waiters);
+}
+
+uint32_t event_group_set(EventGroup* group, uint32_t bits) {
+    disable_interrupts();
+    uint32_t current = set_bits(group, bits);
+    enable_interrupts();
+
+    return current;
+}
+
+uint32_t event_group_set_from_isr(EventGroup* group, uint32_t bits, bool* switch_required) {
+    // A nested ISR or an interrupted clear may touch the same group
+    uint32_t prev = enter_critical_from_isr();
+    uint32_t current = set_bits(group, bits);
+
+    if (switch_required != NULL && task_is_outranked(get_current_task())) {
+        *switch_required = true;
+    }
+
+    exit_critical_from_isr(prev);
+
+    return current;
+}
+
+uint32_t event_group_clear(EventGroup* group, uint32_t bits) {
+    disable_interrupts();
+    group->bits &= ~bits;
+    uint32_t current = group->bits;
+    enable_interrupts();
+
+    return current;
+}
+
+uint32_t event_group_get(const EventGroup* group) {
+    return group->bits;
+}
+
+bool event_group_wait(EventGroup* group, uint32_t bits, uint8_t options, uint32_t timeout, uint32_t* result) {
+    if (bits == 0) {
+        return false;
+    }
+
+    disable_interrupts();
+
+    uint32_t current = group->bits;
+    if (wait_satisfied(current, bits, options)) {
+        if (options & EVENT_CLEAR_ON_EXIT) {
+            group->bits = current & ~bits;
+        }
+        enable_interrupts();
+
+        if (result) {
+            *result = current;
+        }
+        return true;
+    }
+
+    if (timeout == 0) {
+        enable_interrupts();
+        return false;
+    }
+
+    // Block until a set satisfies us, the setter fills in wait.result
+    TCB* current_task = get_current_task();
+    EventWait wait = { .bits = bits, .options = options, .result = 0 };
+
+    current_task->waiting_on = group;
+    current_task->wait_buffer = &wait;
+
+    bool satisfied = waitq_block(&group->waiters, timeout);
+    current_task->waiting_on = NULL;
+    current_task->wait_buffer = NULL;
+
+    enable_interrupts();
+
+    if (satisfied && result) {
+        *result = wait.result;
+    }
+    return satisfied;
+}
@@ -0,0 +1,36 @@
+/* events.h */
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include "rtos_types.h"
+#include "waitq.h"
+
+// Wait options
+#define EVENT_WAIT_ANY       0x00u   // Return when any requested bit is set
+#define EVENT_WAIT_ALL       0x01u   // Return when every requested bit is set
+#define EVENT_CLEAR_ON_EXIT  0x02u   // Clear the requested bits on success
+
+// 32 event flags. One set call wakes every waiter it satisfies.
+typedef struct {
+    volatile uint32_t bits;
+    WaitQueue waiters;
+} EventGroup;
+
+#define EVENT_GROUP_STATIC_INIT { .bits = 0, .waiters = WAITQ_STATIC_INIT }
+
+void event_group_init(EventGroup* group);
+
+// Set, clear and get return the bits as they are after the call. The
+// _from_isr variant sets *switch_required (if not NULL) when it wakes a
+// task that outranks the interrupted one, see yield_from_isr().
+uint32_t event_group_set(EventGroup* group, uint32_t bits);
+uint32_t event_group_set_from_isr(EventGroup* group, uint32_t bits, bool* switch_required);
+uint32_t event_group_clear(EventGroup* group, uint32_t bits);
+uint32_t event_group_get(const EventGroup* group);
+
+// Wait for bits, timeout 0 only polls, WAIT_FOREVER never expires. On success
+// *result (if not NULL) holds the bits that satisfied the wait, before
+// any clear-on-exit.
+bool event_group_wait(EventGroup* group, uint32_t bits, uint8_t options, uint32_t timeout, uint32_t* result);
+
+#endif /* EVENTS_H */
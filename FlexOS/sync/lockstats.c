@@ -0,0 +1,171 @@
+/* lockstats.c */
+#include <stddef.h>
+#include <string.h>
+#include "lockstats.h"
+#include "scheduler.h"
+#include "atomic.h"
+
+#if LOCK_STATS_ENABLE
+
+// Every lock taken at least once, most recent first. Push-only, so it is
+// maintained with compare-and-swap and never needs a critical section.
+static volatile uintptr_t profiled;
+
+static void register_lock(LockStats* stats, const void* lock, uint8_t kind) {
+    if (!atomic_cas_u32(&stats->registered, 0, 1)) {
+        return;
+    }
+
+    stats->kind = kind;
+    stats->lock = lock;
+
+    LockStats* head;
+    do {
+        head = (LockStats*)profiled;
+        stats->next = head;
+    } while (!atomic_cas_word(&profiled, (uintptr_t)head, (uintptr_t)stats));
+}
+
+// Clear a profile from sem_init()/mutex_init(). The object may already be
+// on the report list, in which case it must stay linked exactly once.
+void lock_stats_init(LockStats* stats) {
+    bool listed = false;
+
+    for (LockStats* entry = (LockStats*)profiled; entry != NULL; entry = entry->next) {
+        if (entry == stats) {
+            listed = true;
+            break;
+        }
+    }
+
+    if (!listed) {
+        stats->registered = 0;
+        stats->next = NULL;
+    }
+
+    stats->acquisitions = 0;
+    stats->contended = 0;
+    stats->timeouts = 0;
+    stats->total_wait = 0;
+    stats->max_wait = 0;
+    stats->max_hold = 0;
+    stats->max_hold_task = 0;
+    stats->holder = 0;
+    stats->acquired_at = 0;
+    stats->held = false;
+}
+
+void lock_stats_taken(LockStats* stats, const void* lock, uint8_t kind, uint32_t task_id) {
+    if (!stats->registered) {
+        register_lock(stats, lock, kind);
+    }
+
+    stats->acquisitions++;
+    stats->holder = task_id;
+    stats->acquired_at = get_cycle_count();
+    stats->held = true;
+}
+
+// Record a blocked attempt. Timeouts count too, a lock nobody gets past
+// is the worst kind of contention.
+void lock_stats_waited(LockStats* stats, const void* lock, uint8_t kind, uint32_t wait_start, bool acquired) {
+    uint32_t wait = get_cycle_count() - wait_start;
+
+    if (!stats->registered) {
+        register_lock(stats, lock, kind);
+    }
+
+    stats->contended++;
+    if (!acquired) {
+        stats->timeouts++;
+    }
+    stats->total_wait += wait;
+    if (wait > stats->max_wait) {
+        stats->max_wait = wait;
+    }
+}
+
+// Only a release by the taker ends a hold, so semaphores used for
+// signalling between tasks don't show up as long holds
+void lock_stats_released(LockStats* stats, uint32_t task_id) {
+    if (!stats->held || stats->holder != task_id) {
+        return;
+    }
+
+    uint32_t hold = get_cycle_count() - stats->acquired_at;
+    stats->held = false;
+    if (hold > stats->max_hold) {
+        stats->max_hold = hold;
+        stats->max_hold_task = task_id;
+    }
+}
+
+void lock_stats_get(const LockStats* stats, LockStats* copy) {
+    disable_interrupts();
+    *copy = *stats;
+    enable_interrupts();
+}
+
+void lock_stats_reset(LockStats* stats) {
+    disable_interrupts();
+    stats->acquisitions = 0;
+    stats->contended = 0;
+    stats->timeouts = 0;
+    stats->total_wait = 0;
+    stats->max_wait = 0;
+    stats->max_hold = 0;
+    stats->max_hold_task = 0;
+    stats->held = false;
+    enable_interrupts();
+}
+
+static uint64_t order_key(const LockStats* stats, LockOrder order) {
+    switch (order) {
+        case LOCK_ORDER_MAX_WAIT:  return stats->max_wait;
+        case LOCK_ORDER_MAX_HOLD:  return stats->max_hold;
+        case LOCK_ORDER_CONTENDED: return stats->contended;
+        case LOCK_ORDER_TIMEOUTS:  return stats->timeouts;
+        default:                   return stats->total_wait;
+    }
+}
+
+uint32_t lock_stats_worst(LockReport* reports, uint32_t max_reports, LockOrder order) {
+    uint32_t count = 0;
+
+    if (!reports || max_reports == 0) {
+        return 0;
+    }
+
+    for (LockStats* stats = (LockStats*)profiled; stats != NULL; stats = stats->next) {
+        LockStats copy;
+        lock_stats_get(stats, &copy);
+
+        uint64_t key = order_key(&copy, order);
+        if (key == 0) {
+            continue;
+        }
+
+        // Insertion into the sorted reports, dropping the least bad when full
+        uint32_t slot = count;
+        while (slot > 0 && order_key(&reports[slot - 1].stats, order) < key) {
+            slot--;
+        }
+        if (slot >= max_reports) {
+            continue;
+        }
+
+        uint32_t last = (count < max_reports) ? count : max_reports - 1;
+        memmove(&reports[slot + 1], &reports[slot], (last - slot) * sizeof(LockReport));
+        if (count < max_reports) {
+            count++;
+        }
+
+        reports[slot].lock = copy.lock;
+        reports[slot].kind = copy.kind;
+        reports[slot].stats = copy;
+    }
+
+    return count;
+}
+
+#endif /* LOCK_STATS_ENABLE */
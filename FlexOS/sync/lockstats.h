@@ -0,0 +1,63 @@
+/* lockstats.h */
+#ifndef LOCKSTATS_H
+#define LOCKSTATS_H
+
+#include "rtos_types.h"
+
+// Object a LockReport refers to
+#define LOCK_KIND_SEMAPHORE  0u
+#define LOCK_KIND_MUTEX      1u
+
+// Per-lock profile, times in CPU cycles. Updates from the lock-free fast
+// paths are not atomic, so counts can be slightly off under heavy
+// preemption; the cost is a few loads and stores per operation. A lock
+// joins the report list when first taken and stays on it, so profiled
+// locks must not be freed.
+typedef struct LockStats {
+    uint32_t acquisitions;         // Successful takes, nested mutex locks excluded
+    uint32_t contended;            // Attempts that had to block, timed out or not
+    uint32_t timeouts;             // Blocked attempts that gave up
+    uint64_t total_wait;           // Cycles spent blocked, timeouts included
+    uint32_t max_wait;
+    uint32_t max_hold;             // Longest time from take to release by the same task
+    uint32_t max_hold_task;        // Task that held it for max_hold
+    uint32_t holder;               // Task that took it last
+    uint32_t acquired_at;          // Cycle count at the last take
+    bool held;                     // acquired_at is waiting for a release
+    volatile uint32_t registered;  // Linked into the report list
+    uint8_t kind;                  // LOCK_KIND_*
+    const void* lock;              // Object the profile belongs to
+    struct LockStats* next;        // Next profiled lock
+} LockStats;
+
+typedef enum {
+    LOCK_ORDER_TOTAL_WAIT,
+    LOCK_ORDER_MAX_WAIT,
+    LOCK_ORDER_MAX_HOLD,
+    LOCK_ORDER_CONTENDED,
+    LOCK_ORDER_TIMEOUTS
+} LockOrder;
+
+typedef struct {
+    const void* lock;              // Semaphore or Mutex, see kind
+    uint8_t kind;
+    LockStats stats;
+} LockReport;
+
+#if LOCK_STATS_ENABLE
+// Hooks used by the lock implementations
+void lock_stats_init(LockStats* stats);
+void lock_stats_taken(LockStats* stats, const void* lock, uint8_t kind, uint32_t task_id);
+void lock_stats_waited(LockStats* stats, const void* lock, uint8_t kind, uint32_t wait_start, bool acquired);
+void lock_stats_released(LockStats* stats, uint32_t task_id);
+
+// Copy out or clear one profile
+void lock_stats_get(const LockStats* stats, LockStats* copy);
+void lock_stats_reset(LockStats* stats);
+
+// Fill reports with the worst locks used so far, worst first. Returns
+// the number of reports written.
+uint32_t lock_stats_worst(LockReport* reports, uint32_t max_reports, LockOrder order);
+#endif
+
+#endif /* LOCKSTATS_H */
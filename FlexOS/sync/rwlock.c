@@ -0,0 +1,116 @@
+/* rwlock.c */
+#include <stddef.h>
+#include "rwlock.h"
+#include "scheduler.h"
+
+// Let every waiting reader in, highest priority first. Called with
+// interrupts disabled.
+static void admit_readers(RWLock* rw) {
+    TCB* task;
+
+    while ((task = waitq_pop(&rw->read_waiters)) != NULL) {
+        rw->readers++;
+        unblock_task(task);
+    }
+}
+
+// Pass a free lock on to the waiters. Called with interrupts disabled.
+static void grant_waiters(RWLock* rw) {
+    TCB* writer = waitq_peek(&rw->write_waiters);
+    TCB* reader = waitq_peek(&rw->read_waiters);
+
+    // Writers win ties so they can't be starved, but not against a more
+    // urgent reader
+    if (writer != NULL && (reader == NULL || writer->priority >= reader->priority)) {
+        waitq_pop(&rw->write_waiters);
+        rw->writer = writer;
+        unblock_task(writer);
+    } else {
+        admit_readers(rw);
+    }
+}
+
+void rwlock_init(RWLock* rw) {
+    rw->readers = 0;
+    rw->writer = NULL;
+    waitq_init(&rw->read_waiters);
+    waitq_init(&rw->write_waiters);
+}
+
+bool rwlock_read_lock(RWLock* rw, uint32_t timeout) {
+    disable_interrupts();
+
+    // Queue behind waiting writers rather than overtaking them
+    if (rw->writer == NULL && waitq_is_empty(&rw->write_waiters)) {
+        rw->readers++;
+        enable_interrupts();
+        return true;
+    }
+
+    if (timeout == 0) {
+        enable_interrupts();
+        return false;
+    }
+
+    TCB* current_task = get_current_task();
+    current_task->waiting_on = rw;
+
+    // The releasing task counts us in before waking us
+    bool acquired = waitq_block(&rw->read_waiters, timeout);
+    current_task->waiting_on = NULL;
+
+    enable_interrupts();
+    return acquired;
+}
+
+void rwlock_read_unlock(RWLock* rw) {
+    disable_interrupts();
+
+    if (rw->readers > 0 && --rw->readers == 0) {
+        grant_waiters(rw);
+    }
+
+    enable_interrupts();
+}
+
+bool rwlock_write_lock(RWLock* rw, uint32_t timeout) {
+    disable_interrupts();
+
+    TCB* current_task = get_current_task();
+
+    if (rw->writer == NULL && rw->readers == 0) {
+        rw->writer = current_task;
+        enable_interrupts();
+        return true;
+    }
+
+    if (timeout == 0) {
+        enable_interrupts();
+        return false;
+    }
+
+    current_task->waiting_on = rw;
+
+    // The releasing task makes us the writer before waking us
+    bool acquired = waitq_block(&rw->write_waiters, timeout);
+    current_task->waiting_on = NULL;
+
+    // Readers held back only by us can go now
+    if (!acquired && rw->writer == NULL && waitq_is_empty(&rw->write_waiters)) {
+        admit_readers(rw);
+    }
+
+    enable_interrupts();
+    return acquired;
+}
+
+void rwlock_write_unlock(RWLock* rw) {
+    disable_interrupts();
+
+    if (rw->writer == get_current_task()) {
+        rw->writer = NULL;
+        grant_waiters(rw);
+    }
+
+    enable_interrupts();
+}
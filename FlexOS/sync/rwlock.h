@@ -0,0 +1,32 @@
+/* rwlock.h */
+#ifndef RWLOCK_H
+#define RWLOCK_H
+
+#include "rtos_types.h"
+#include "waitq.h"
+
+// Many readers or one writer. Waiting writers hold back new readers so
+// they cannot be starved; when a writer releases, the most urgent waiter
+// decides whether the next writer or every waiting reader goes first.
+typedef struct {
+    uint32_t readers;              // Tasks holding the lock for reading
+    TCB* writer;                   // Task holding the lock for writing, NULL if none
+    WaitQueue read_waiters;        // Readers blocked by a writer
+    WaitQueue write_waiters;       // Writers blocked by readers or a writer
+} RWLock;
+
+#define RWLOCK_STATIC_INIT {                 \
+    .readers = 0,                            \
+    .writer = NULL,                          \
+    .read_waiters = WAITQ_STATIC_INIT,       \
+    .write_waiters = WAITQ_STATIC_INIT       \
+}
+
+// Timeout 0 only tries, WAIT_FOREVER never expires
+void rwlock_init(RWLock* rw);
+bool rwlock_read_lock(RWLock* rw, uint32_t timeout);
+void rwlock_read_unlock(RWLock* rw);
+bool rwlock_write_lock(RWLock* rw, uint32_t timeout);
+void rwlock_write_unlock(RWLock* rw);
+
+#endif /* RWLOCK_H */
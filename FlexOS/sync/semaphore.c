@@ -1,124 +1,599 @@
-
-
 /* sync.c */
-#include "sync.h"
+#include <stddef.h>
+#include "semaphore.h"
 #include "scheduler.h"
+#include "atomic.h"
+#include "queueset.h"
+
+#if LOCK_STATS_ENABLE
+static inline uint32_t stats_now(void) {
+    return get_cycle_count();
+}
+
+static inline void sem_stats_taken(Semaphore* sem) {
+    lock_stats_taken(&sem->stats, sem, LOCK_KIND_SEMAPHORE, get_current_task_id());
+}
+
+static inline void sem_stats_waited(Semaphore* sem, uint32_t wait_start, bool acquired) {
+    lock_stats_waited(&sem->stats, sem, LOCK_KIND_SEMAPHORE, wait_start, acquired);
+}
+
+static inline void sem_stats_released(Semaphore* sem) {
+    lock_stats_released(&sem->stats, get_current_task_id());
+}
+
+static inline void mutex_stats_taken(Mutex* mutex, const TCB* task) {
+    lock_stats_taken(&mutex->stats, mutex, LOCK_KIND_MUTEX, get_task_id(task));
+}
+
+static inline void mutex_stats_waited(Mutex* mutex, uint32_t wait_start, bool acquired) {
+    lock_stats_waited(&mutex->stats, mutex, LOCK_KIND_MUTEX, wait_start, acquired);
+}
+
+static inline void mutex_stats_released(Mutex* mutex, const TCB* task) {
+    lock_stats_released(&mutex->stats, get_task_id(task));
+}
+#else
+static inline uint32_t stats_now(void) {
+    return 0;
+}
+
+static inline void sem_stats_taken(Semaphore* sem) {
+    (void)sem;
+}
+
+static inline void sem_stats_waited(Semaphore* sem, uint32_t wait_start, bool acquired) {
+    (void)sem; (void)wait_start; (void)acquired;
+}
+
+static inline void sem_stats_released(Semaphore* sem) {
+    (void)sem;
+}
+
+static inline void mutex_stats_taken(Mutex* mutex, const TCB* task) {
+    (void)mutex; (void)task;
+}
+
+static inline void mutex_stats_waited(Mutex* mutex, uint32_t wait_start, bool acquired) {
+    (void)mutex; (void)wait_start; (void)acquired;
+}
+
+static inline void mutex_stats_released(Mutex* mutex, const TCB* task) {
+    (void)mutex; (void)task;
+}
+#endif
 
 void sem_init(Semaphore* sem, uint32_t initial_count) {
     sem->count = initial_count;
-    sem->waiting_list = NULL;
+    waitq_init(&sem->waiters);
+    sem->queue_set = NULL;
+#if LOCK_STATS_ENABLE
+    lock_stats_init(&sem->stats);
+#endif
 }
 
 bool sem_wait(Semaphore* sem, uint32_t timeout) {
+    // Fast path: take an available count without masking interrupts
+    uint32_t count = sem->count;
+    while (count != 0 && (count & SEM_WAITERS) == 0) {
+        if (atomic_cas_u32(&sem->count, count, count - 1)) {
+            sem_stats_taken(sem);
+            return true;
+        }
+        count = sem->count;
+    }
+
     // Disable interrupts
     disable_interrupts();
 
-    if (sem->count > 0) {
+    if (sem_get_count(sem) > 0) {
         sem->count--;
+        sem_stats_taken(sem);
         enable_interrupts();
         return true;
     }
 
-    // No resources available, block task
+    // No resources available, block task until sem_signal() hands us the count
     TCB* current_task = get_current_task();
     current_task->waiting_on = sem;
-    current_task->blocked_timeout = timeout;
+    sem->count |= SEM_WAITERS;
+
+    uint32_t wait_start = stats_now();
+    bool acquired = waitq_block(&sem->waiters, timeout);
+    current_task->waiting_on = NULL;
+
+    if (waitq_is_empty(&sem->waiters)) {
+        sem->count &= ~SEM_WAITERS;
+    }
 
-    // Add to waiting list
-    current_task->next = sem->waiting_list;
-    sem->waiting_list = current_task;
+    if (acquired) {
+        sem_stats_taken(sem);
+    }
+    sem_stats_waited(sem, wait_start, acquired);
 
-    block_task(timeout);
     enable_interrupts();
+    return acquired;
+}
+
+// Fast path: add count without masking interrupts while nobody waits and
+// no queue set needs telling. Returns false if the slow path is needed.
+static bool add_count(Semaphore* sem, uint32_t units) {
+    if (sem->queue_set != NULL) {
+        return false;
+    }
+
+    uint32_t count = sem->count;
+    while ((count & SEM_WAITERS) == 0) {
+        if (atomic_cas_u32(&sem->count, count, count + units)) {
+            return true;
+        }
+        count = sem->count;
+    }
 
-    // When task resumes, check if it was due to timeout
-    return current_task->waiting_on == NULL;
+    return false;
+}
+
+// Pass units to waiting tasks, highest priority first, and bank the rest.
+// Returns true if a woken task outranks the running one. Called with
+// interrupts disabled.
+static bool give_units(Semaphore* sem, uint32_t units) {
+    uint8_t running = get_current_task()->priority;
+    bool switch_required = false;
+
+    while (units > 0) {
+        TCB* task = waitq_wake_one(&sem->waiters);
+        if (task == NULL) {
+            break;
+        }
+
+        if (task->priority > running) {
+            switch_required = true;
+        }
+        units--;
+    }
+
+    if (waitq_is_empty(&sem->waiters)) {
+        sem->count &= ~SEM_WAITERS;
+    }
+
+    if (units > 0) {
+        sem->count += units;
+
+        // The set sees one entry per unit, as with repeated sem_signal() calls
+        if (sem->queue_set != NULL) {
+            while (units-- > 0) {
+                queueset_notify(sem->queue_set, sem);
+            }
+        }
+    }
+
+    return switch_required;
 }
 
 void sem_signal(Semaphore* sem) {
+    sem_stats_released(sem);
+
+    if (add_count(sem, 1)) {
+        return;
+    }
+
     disable_interrupts();
+    bool switch_required = give_units(sem, 1);
+    enable_interrupts();
+
+    if (switch_required) {
+        request_context_switch();
+    }
+}
 
-    sem->count++;
+void sem_signal_n(Semaphore* sem, uint32_t count) {
+    if (count == 0) {
+        return;
+    }
 
-    // If tasks are waiting, wake up the first one
-    if (sem->waiting_list != NULL) {
-        TCB* task = sem->waiting_list;
-        sem->waiting_list = task->next;
-        task->next = NULL;
-        task->waiting_on = NULL;
-        task->state = TASK_READY;
-        sem->count--;
+    sem_stats_released(sem);
+
+    if (add_count(sem, count)) {
+        return;
     }
 
+    disable_interrupts();
+    bool switch_required = give_units(sem, count);
     enable_interrupts();
+
+    if (switch_required) {
+        request_context_switch();
+    }
+}
+
+void sem_signal_from_isr(Semaphore* sem, bool* switch_required) {
+    sem_signal_n_from_isr(sem, 1, switch_required);
+}
+
+void sem_signal_n_from_isr(Semaphore* sem, uint32_t count, bool* switch_required) {
+    if (count == 0 || add_count(sem, count)) {
+        return;
+    }
+
+    // Another kernel-aware ISR may preempt us and signal the same semaphore
+    uint32_t prev = enter_critical_from_isr();
+    bool woken = give_units(sem, count);
+    exit_critical_from_isr(prev);
+
+    if (woken && switch_required) {
+        *switch_required = true;
+    }
+}
+
+// Priority a task is entitled to: its own, the ceiling of a mutex it
+// holds, or that of the most urgent task waiting for one
+static uint8_t held_priority(const Mutex* held, uint8_t priority) {
+    if (held->ceiling > priority) {
+        priority = held->ceiling;
+    }
+
+    const TCB* waiter = waitq_peek(&held->waiters);
+    if (waiter != NULL && waiter->priority > priority) {
+        priority = waiter->priority;
+    }
+
+    return priority;
+}
+
+static uint8_t effective_priority(const TCB* task) {
+    uint8_t priority = task->base_priority;
+
+    for (const Mutex* held = task->held_mutexes; held != NULL; held = held->next_held) {
+        priority = held_priority(held, priority);
+    }
+
+    // A lock-free lock or unlock may own a mutex that is not on the list yet
+    const Mutex* pending = task->fast_mutex;
+    if (pending != NULL && mutex_get_owner(pending) == task) {
+        priority = held_priority(pending, priority);
+    }
+
+    return priority;
+}
+
+// Lend priority to the owner of mutex, and on to whoever that owner is
+// blocked behind. Bounded so a deadlock cycle can't spin forever.
+static void inherit_priority(Mutex* mutex, uint8_t priority) {
+    for (uint32_t depth = 0; mutex != NULL && mutex_get_owner(mutex) != NULL && depth < MAX_TASKS; depth++) {
+        TCB* owner = mutex_get_owner(mutex);
+        if (owner->priority >= priority) {
+            break;
+        }
+
+        waitq_set_priority(owner, priority);
+        mutex = owner->blocked_mutex;
+    }
+}
+
+// Recompute the owner chain after a waiter left without taking mutex
+static void restore_priority(Mutex* mutex) {
+    for (uint32_t depth = 0; mutex != NULL && mutex_get_owner(mutex) != NULL && depth < MAX_TASKS; depth++) {
+        TCB* owner = mutex_get_owner(mutex);
+        uint8_t priority = effective_priority(owner);
+        if (priority == owner->priority) {
+            break;
+        }
+
+        waitq_set_priority(owner, priority);
+        mutex = owner->blocked_mutex;
+    }
+}
+
+static void take_ownership(Mutex* mutex, TCB* task) {
+    mutex->lock = (uintptr_t)task | (waitq_is_empty(&mutex->waiters) ? 0 : MUTEX_CONTENDED);
+    mutex->count = 1;
+    mutex->next_held = task->held_mutexes;
+    task->held_mutexes = mutex;
+    mutex_stats_taken(mutex, task);
+}
+
+static void drop_ownership(Mutex* mutex, TCB* task) {
+    Mutex** link = &task->held_mutexes;
+
+    mutex_stats_released(mutex, task);
+
+    while (*link != NULL && *link != mutex) {
+        link = &(*link)->next_held;
+    }
+    if (*link == mutex) {
+        *link = mutex->next_held;
+    }
+
+    mutex->lock = 0;
+    mutex->next_held = NULL;
 }
 
 void mutex_init(Mutex* mutex) {
-    mutex->owner = NULL;
+    mutex->lock = 0;
     mutex->count = 0;
-    mutex->waiting_list = NULL;
+    waitq_init(&mutex->waiters);
+    mutex->next_held = NULL;
+    mutex->ceiling = 0;
+#if LOCK_STATS_ENABLE
+    lock_stats_init(&mutex->stats);
+#endif
 }
 
-bool mutex_lock(Mutex* mutex, uint32_t timeout) {
-    disable_interrupts();
-
-    TCB* current_task = get_current_task();
+// ceiling must be at least the priority of every task that locks the mutex
+void mutex_init_ceiling(Mutex* mutex, uint8_t ceiling) {
+    mutex_init(mutex);
+    mutex->ceiling = ceiling;
+}
 
+// Take mutex for task, blocking up to timeout. Called with interrupts disabled.
+static bool lock_mutex(Mutex* mutex, TCB* current_task, uint32_t timeout) {
     // Check if current task already owns the mutex
-    if (mutex->owner == current_task) {
+    if (mutex_get_owner(mutex) == current_task) {
         mutex->count++;
-        enable_interrupts();
         return true;
     }
 
-    // If mutex is free, take it
-    if (mutex->owner == NULL) {
-        mutex->owner = current_task;
-        mutex->count = 1;
-        enable_interrupts();
+    // A task above the ceiling could preempt the owner, refuse it
+    if (mutex->ceiling != 0 && current_task->base_priority > mutex->ceiling) {
+        return false;
+    }
+
+    // If mutex is free, take it, running at the ceiling right away
+    if (mutex_get_owner(mutex) == NULL) {
+        take_ownership(mutex, current_task);
+        if (mutex->ceiling > current_task->priority) {
+            current_task->priority = mutex->ceiling;
+        }
         return true;
     }
 
-    // Mutex is taken, block task
+    // Mutex is taken, boost the owner chain and block until mutex_unlock()
+    // makes us the owner. A ceiling mutex only gets here if tasks already
+    // at its ceiling share it.
     current_task->waiting_on = mutex;
-    current_task->blocked_timeout = timeout;
+    current_task->blocked_mutex = mutex;
+    mutex->lock |= MUTEX_CONTENDED;
+    inherit_priority(mutex, current_task->priority);
 
-    // Add to waiting list
-    current_task->next = mutex->waiting_list;
-    mutex->waiting_list = current_task;
+    uint32_t wait_start = stats_now();
+    bool acquired = waitq_block(&mutex->waiters, timeout);
+    current_task->waiting_on = NULL;
+    current_task->blocked_mutex = NULL;
 
-    block_task(timeout);
-    enable_interrupts();
+    // The owner may have been running on our priority
+    if (!acquired) {
+        restore_priority(mutex);
+    }
 
-    return current_task->waiting_on == NULL;
+    mutex_stats_waited(mutex, wait_start, acquired);
+
+    return acquired;
 }
 
-void mutex_unlock(Mutex* mutex) {
+// Release mutex completely and pass it on. Returns true if the caller
+// should reschedule because, with any inherited or ceiling priority given
+// up, the new owner or another ready task outranks it. Called with
+// interrupts disabled.
+static bool release_mutex(Mutex* mutex, TCB* current_task) {
+    drop_ownership(mutex, current_task);
+
+    // Give the mutex to the highest priority waiting task, if any. It
+    // inherits from the waiters still queued behind it.
+    TCB* task = waitq_wake_one(&mutex->waiters);
+    if (task != NULL) {
+        task->blocked_mutex = NULL;
+        take_ownership(mutex, task);
+        waitq_set_priority(task, effective_priority(task));
+    }
+
+    // Give up whatever priority was inherited through this mutex
+    waitq_set_priority(current_task, effective_priority(current_task));
+
+    // The new owner is ready now, so this also covers it
+    return task_is_outranked(current_task);
+}
+
+bool mutex_lock(Mutex* mutex, uint32_t timeout) {
+    TCB* current_task = get_current_task();
+
+    // Fast path: claim a free mutex without masking interrupts. Ceiling
+    // mutexes change priority, so they always take the slow path. Until
+    // the mutex is on held_mutexes, fast_mutex lets effective_priority()
+    // see it.
+    if (mutex->ceiling == 0) {
+        current_task->fast_mutex = mutex;
+        ATOMIC_COMPILER_BARRIER();
+
+        if (atomic_cas_word(&mutex->lock, 0, (uintptr_t)current_task)) {
+            mutex->count = 1;
+            mutex->next_held = current_task->held_mutexes;
+            ATOMIC_COMPILER_BARRIER();
+            current_task->held_mutexes = mutex;
+            ATOMIC_COMPILER_BARRIER();
+            current_task->fast_mutex = NULL;
+            mutex_stats_taken(mutex, current_task);
+            return true;
+        }
+
+        current_task->fast_mutex = NULL;
+    }
+
+    // Only the owner touches the count while it holds the mutex
+    if (mutex_get_owner(mutex) == current_task) {
+        mutex->count++;
+        return true;
+    }
+
     disable_interrupts();
+    bool acquired = lock_mutex(mutex, current_task, timeout);
+    enable_interrupts();
 
+    return acquired;
+}
+
+void mutex_unlock(Mutex* mutex) {
     TCB* current_task = get_current_task();
 
-    // Check if current task owns the mutex
-    if (mutex->owner != current_task) {
-        enable_interrupts();
+    // Check if current task owns the mutex, then decrease count for nested locks
+    if (mutex_get_owner(mutex) != current_task) {
         return;
     }
 
-    // Decrease count for nested locks
-    if (--mutex->count == 0) {
-        // If tasks are waiting, give mutex to first waiting task
-        if (mutex->waiting_list != NULL) {
-            TCB* task = mutex->waiting_list;
-            mutex->waiting_list = task->next;
-            task->next = NULL;
-            task->waiting_on = NULL;
-            task->state = TASK_READY;
-            mutex->owner = task;
+    if (mutex->count > 1) {
+        mutex->count--;
+        return;
+    }
+
+    // Fast path: the most recently taken mutex with nobody waiting. Unlink
+    // it first so a new owner never shares our held list; fast_mutex keeps
+    // it visible to effective_priority() meanwhile.
+    if (mutex->ceiling == 0 && current_task->held_mutexes == mutex) {
+        mutex_stats_released(mutex, current_task);
+        current_task->fast_mutex = mutex;
+        ATOMIC_COMPILER_BARRIER();
+        current_task->held_mutexes = mutex->next_held;
+        mutex->count = 0;
+        ATOMIC_COMPILER_BARRIER();
+
+        bool released = atomic_cas_word(&mutex->lock, (uintptr_t)current_task, 0);
+        if (!released) {
+            // A waiter arrived, put things back and hand over on the slow path
             mutex->count = 1;
-        } else {
-            mutex->owner = NULL;
+            current_task->held_mutexes = mutex;
         }
+
+        ATOMIC_COMPILER_BARRIER();
+        current_task->fast_mutex = NULL;
+
+        if (released) {
+            return;
+        }
+    }
+
+    disable_interrupts();
+
+    bool switch_required = false;
+    if (--mutex->count == 0) {
+        switch_required = release_mutex(mutex, current_task);
+    }
+
+    enable_interrupts();
+
+    // Let the new owner, or whoever we were holding off, run now rather
+    // than whenever we next block
+    if (switch_required) {
+        request_context_switch();
+    }
+}
+
+// Move a task waiting on a condition to the mutex it has to reacquire.
+// It stays blocked until the mutex is handed to it. Called with
+// interrupts disabled.
+static void requeue_on_mutex(TCB* task) {
+    Mutex* mutex = (Mutex*)task->wait_buffer;
+
+    waitq_remove(task);
+
+    if (mutex_get_owner(mutex) == NULL) {
+        take_ownership(mutex, task);
+        waitq_set_priority(task, effective_priority(task));
+        unblock_task(task);
+        return;
+    }
+
+    task->waiting_on = mutex;
+    task->blocked_mutex = mutex;
+    waitq_insert(&mutex->waiters, task);
+    mutex->lock |= MUTEX_CONTENDED;
+    inherit_priority(mutex, task->priority);
+}
+
+void cond_init(CondVar* cond) {
+    waitq_init(&cond->waiters);
+}
+
+bool cond_wait(CondVar* cond, Mutex* mutex, uint32_t timeout) {
+    disable_interrupts();
+
+    TCB* current_task = get_current_task();
+
+    if (mutex_get_owner(mutex) != current_task || timeout == 0) {
+        enable_interrupts();
+        return false;
+    }
+
+    // Release the mutex fully, nested locks included, and wait on cond
+    uint32_t count = mutex->count;
+    release_mutex(mutex, current_task);
+
+    current_task->waiting_on = cond;
+    current_task->wait_buffer = mutex;
+
+    // A signal moves us to the mutex wait list, so waking means we own it
+    bool signalled = waitq_block(&cond->waiters, timeout);
+    current_task->waiting_on = NULL;
+    current_task->wait_buffer = NULL;
+    current_task->blocked_mutex = NULL;
+
+    if (!signalled) {
+        // Timed out, possibly already requeued behind the owner. The
+        // mutex is held again on return either way.
+        restore_priority(mutex);
+        lock_mutex(mutex, current_task, 0);
+    }
+
+    mutex->count = count;
+
+    enable_interrupts();
+    return signalled;
+}
+
+void cond_signal(CondVar* cond) {
+    disable_interrupts();
+
+    TCB* task = waitq_peek(&cond->waiters);
+    if (task != NULL) {
+        requeue_on_mutex(task);
     }
 
     enable_interrupts();
 }
+
+// Waiters are moved onto the mutex rather than woken, so they run one
+// at a time as the mutex is passed along
+void cond_broadcast(CondVar* cond) {
+    disable_interrupts();
+
+    TCB* task;
+    while ((task = waitq_peek(&cond->waiters)) != NULL) {
+        requeue_on_mutex(task);
+    }
+
+    enable_interrupts();
+}
+
+#if LOCK_STATS_ENABLE
+void sem_get_stats(const Semaphore* sem, LockStats* stats) {
+    if (sem && stats) {
+        lock_stats_get(&sem->stats, stats);
+    }
+}
+
+void sem_reset_stats(Semaphore* sem) {
+    if (sem) {
+        lock_stats_reset(&sem->stats);
+    }
+}
+
+void mutex_get_stats(const Mutex* mutex, LockStats* stats) {
+    if (mutex && stats) {
+        lock_stats_get(&mutex->stats, stats);
+    }
+}
+
+void mutex_reset_stats(Mutex* mutex) {
+    if (mutex) {
+        lock_stats_reset(&mutex->stats);
+    }
+}
+#endif
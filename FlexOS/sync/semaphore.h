@@ -3,26 +3,96 @@
 #define SYNC_H
 
 #include "rtos_types.h"
+#include "waitq.h"
+#include "lockstats.h"
+
+struct QueueSet;
+
+// Set in Semaphore.count while tasks are blocked, forcing sem_signal()
+// onto the slow path
+#define SEM_WAITERS      0x80000000u
+
+// Set in Mutex.lock while tasks may be waiting, forcing mutex_unlock()
+// onto the slow path
+#define MUTEX_CONTENDED  ((uintptr_t)1)
 
 typedef struct {
-    uint32_t count;
-    TCB* waiting_list;
+    volatile uint32_t count;      // Available count, plus SEM_WAITERS
+    WaitQueue waiters;
+    struct QueueSet* queue_set;   // Set told about signals, NULL if none
+#if LOCK_STATS_ENABLE
+    LockStats stats;              // Contention profile
+#endif
 } Semaphore;
 
-typedef struct {
-    TCB* owner;
+// Mutexes use priority inheritance: while a task waits, the owner (and
+// whoever that owner is waiting for in turn) runs at the waiter's priority.
+// A mutex with a ceiling instead raises its owner to the ceiling as soon
+// as it is taken, so no task that uses it can preempt the owner.
+typedef struct Mutex {
+    volatile uintptr_t lock;      // Owner TCB address, plus MUTEX_CONTENDED
     uint32_t count;
-    TCB* waiting_list;
+    WaitQueue waiters;
+    struct Mutex* next_held;      // Next mutex owned by the same task
+    uint8_t ceiling;              // Priority ceiling, 0 for priority inheritance
+#if LOCK_STATS_ENABLE
+    LockStats stats;              // Contention profile
+#endif
 } Mutex;
 
-// Semaphore functions
+// Condition variable, always used with a Mutex
+typedef struct {
+    WaitQueue waiters;
+} CondVar;
+
+// Compile-time initializers, equivalent to sem_init()/mutex_init()
+#define SEMAPHORE_STATIC_INIT(initial_count) { .count = (initial_count), .waiters = WAITQ_STATIC_INIT, .queue_set = NULL }
+#define MUTEX_STATIC_INIT                    { .lock = 0, .count = 0, .waiters = WAITQ_STATIC_INIT, .next_held = NULL, .ceiling = 0 }
+#define MUTEX_CEILING_STATIC_INIT(prio)      { .lock = 0, .count = 0, .waiters = WAITQ_STATIC_INIT, .next_held = NULL, .ceiling = (prio) }
+#define COND_STATIC_INIT                     { .waiters = WAITQ_STATIC_INIT }
+
+static inline uint32_t sem_get_count(const Semaphore* sem) {
+    return sem->count & ~SEM_WAITERS;
+}
+
+static inline TCB* mutex_get_owner(const Mutex* mutex) {
+    return (TCB*)(mutex->lock & ~MUTEX_CONTENDED);
+}
+
+// Semaphore functions. sem_wait() and mutex_lock() treat timeout 0 as
+// forever, as does WAIT_FOREVER.
 void sem_init(Semaphore* sem, uint32_t initial_count);
 bool sem_wait(Semaphore* sem, uint32_t timeout);
 void sem_signal(Semaphore* sem);
 
+// Give count units at once, waking up to count waiters in one pass and
+// rescheduling at most once. The _from_isr variants never reschedule;
+// they set *switch_required (if not NULL) when a woken task outranks the
+// interrupted one, for yield_from_isr() at the end of the ISR.
+void sem_signal_n(Semaphore* sem, uint32_t count);
+void sem_signal_from_isr(Semaphore* sem, bool* switch_required);
+void sem_signal_n_from_isr(Semaphore* sem, uint32_t count, bool* switch_required);
+
 // Mutex functions
 void mutex_init(Mutex* mutex);
+void mutex_init_ceiling(Mutex* mutex, uint8_t ceiling);
 bool mutex_lock(Mutex* mutex, uint32_t timeout);
 void mutex_unlock(Mutex* mutex);
 
+// Condition variable functions. cond_wait() releases the mutex while it
+// waits and always holds it again on return; false means it timed out.
+// Timeout 0 returns false at once, WAIT_FOREVER never expires.
+void cond_init(CondVar* cond);
+bool cond_wait(CondVar* cond, Mutex* mutex, uint32_t timeout);
+void cond_signal(CondVar* cond);
+void cond_broadcast(CondVar* cond);
+
+#if LOCK_STATS_ENABLE
+// Profiles, see lock_stats_worst() for the locks that hurt most
+void sem_get_stats(const Semaphore* sem, LockStats* stats);
+void sem_reset_stats(Semaphore* sem);
+void mutex_get_stats(const Mutex* mutex, LockStats* stats);
+void mutex_reset_stats(Mutex* mutex);
+#endif
+
 #endif /* SYNC_H */